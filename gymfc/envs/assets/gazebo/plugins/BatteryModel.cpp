@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <algorithm>
+
+#include <gazebo/common/common.hh>
+
+#include "BatteryModel.hh"
+
+using namespace gazebo;
+
+/////////////////////////////////////////////////
+bool BatteryModel::Load(sdf::ElementPtr _sdf)
+{
+  this->enabled = false;
+  if (!_sdf->HasElement("capacity") || !_sdf->HasElement("cells"))
+  {
+    gzerr << "Battery model requires a capacity and number of cells\n";
+    return false;
+  }
+  this->capacity = _sdf->Get<double>("capacity");
+  this->cells = _sdf->Get<double>("cells");
+  this->cellFullVoltage = _sdf->HasElement("cellFullVoltage") ?
+    _sdf->Get<double>("cellFullVoltage") : 4.2;
+  this->cellEmptyVoltage = _sdf->HasElement("cellEmptyVoltage") ?
+    _sdf->Get<double>("cellEmptyVoltage") : 3.3;
+  this->internalResistance = _sdf->HasElement("internalResistance") ?
+    _sdf->Get<double>("internalResistance") : 0;
+  this->initialStateOfCharge = _sdf->HasElement("initialStateOfCharge") ?
+    _sdf->Get<double>("initialStateOfCharge") : 1;
+
+  if (this->capacity <= 0 || this->cells <= 0 ||
+      this->cellEmptyVoltage > this->cellFullVoltage)
+  {
+    gzerr << "Invalid battery model parameters\n";
+    return false;
+  }
+  this->enabled = true;
+  this->stateOfCharge = this->initialStateOfCharge;
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool BatteryModel::Enabled() const
+{
+  return this->enabled;
+}
+
+/////////////////////////////////////////////////
+void BatteryModel::Reset(gymfc::msgs::State &_state)
+{
+  this->stateOfCharge = this->initialStateOfCharge;
+  this->Report(_state, 0);
+}
+
+/////////////////////////////////////////////////
+void BatteryModel::Update(gymfc::msgs::State &_state, const double _dt)
+{
+  double current = 0;
+  for (int i = 0; i < _state.esc_current_size(); i++)
+  {
+    current += _state.esc_current(i);
+  }
+  // Ignore the negative placeholder until the ESCs report
+  current = std::max(0.0, current);
+
+  this->stateOfCharge = std::max(0.0,
+      this->stateOfCharge - current * _dt / (this->capacity * 3600));
+  this->Report(_state, current);
+}
+
+/////////////////////////////////////////////////
+void BatteryModel::Report(gymfc::msgs::State &_state,
+    const double _current) const
+{
+  double openCircuit = this->cells * (this->cellEmptyVoltage +
+      this->stateOfCharge * (this->cellFullVoltage - this->cellEmptyVoltage));
+  _state.set_vbat_voltage(std::max(0.0,
+        openCircuit - _current * this->internalResistance));
+  _state.set_vbat_current(_current);
+  _state.set_vbat_state_of_charge(this->stateOfCharge);
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GAZEBO_PLUGINS_BATTERYMODEL_HH_
+#define GAZEBO_PLUGINS_BATTERYMODEL_HH_
+
+#include <sdf/sdf.hh>
+
+#include "State.pb.h"
+
+namespace gazebo
+{
+  /// \brief Battery pack integrated by the plugin from the ESC currents of
+  // every step, so the twin does not need to publish a battery sensor.
+  // The open circuit voltage falls linearly with the state of charge from
+  // the full to the empty cell voltage, and the pack sags by the current
+  // times its internal resistance. Configured in the plugin SDF,
+  //
+  //  <batteryModel>
+  //    <capacity>1.3</capacity>                    Amp hours
+  //    <cells>4</cells>
+  //    <cellFullVoltage>4.2</cellFullVoltage>
+  //    <cellEmptyVoltage>3.3</cellEmptyVoltage>
+  //    <internalResistance>0.02</internalResistance>  Ohm for the pack
+  //    <initialStateOfCharge>1</initialStateOfCharge>
+  //  </batteryModel>
+  class BatteryModel
+  {
+    /// \brief Load the pack parameters
+    /// \return False if the parameters are invalid
+    public: bool Load(sdf::ElementPtr _sdf);
+
+    /// \brief True once a valid pack was loaded
+    public: bool Enabled() const;
+
+    /// \brief Charge the pack to its initial state of charge and report
+    // the resting voltage
+    public: void Reset(gymfc::msgs::State &_state);
+
+    /// \brief Drain the pack by the total ESC current over the step and
+    // report the loaded voltage, current and state of charge
+    /// \param[in] _dt Step size in seconds
+    public: void Update(gymfc::msgs::State &_state, const double _dt);
+
+    private: void Report(gymfc::msgs::State &_state, const double _current) const;
+
+    private: bool enabled = false;
+    private: double capacity = 0;
+    private: double cells = 0;
+    private: double cellFullVoltage = 0;
+    private: double cellEmptyVoltage = 0;
+    private: double internalResistance = 0;
+    private: double initialStateOfCharge = 1;
+    private: double stateOfCharge = 1;
+  };
+}
+#endif
@@ -0,0 +1,239 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+
+#include <boost/algorithm/string.hpp>
+#include <gazebo/common/common.hh>
+
+#include "DynoProfile.hh"
+
+using namespace gazebo;
+
+/////////////////////////////////////////////////
+bool DynoProfile::Load(sdf::ElementPtr _sdf)
+{
+  std::string typeName = _sdf->GetAttribute("type")->GetAsString();
+  if (!_sdf->HasElement("duration"))
+  {
+    gzerr << "Dyno profile " << typeName << " requires a duration\n";
+    return false;
+  }
+  this->duration = _sdf->Get<double>("duration");
+
+  // Every value of a profile is required except the ramp peakTime
+  auto require = [&](const std::initializer_list<const char *> &_names)
+  {
+    for (const char *name : _names)
+    {
+      if (!_sdf->HasElement(name))
+      {
+        gzerr << "Dyno profile " << typeName << " requires " << name << "\n";
+        return false;
+      }
+    }
+    return true;
+  };
+
+  if (boost::iequals(typeName, "step"))
+  {
+    if (!require({"low", "high", "stepTime"}))
+    {
+      return false;
+    }
+    this->type = STEP;
+    this->low = _sdf->Get<double>("low");
+    this->high = _sdf->Get<double>("high");
+    this->switchTime = _sdf->Get<double>("stepTime");
+  }
+  else if (boost::iequals(typeName, "ramp"))
+  {
+    if (!require({"low", "high"}))
+    {
+      return false;
+    }
+    this->type = RAMP;
+    this->low = _sdf->Get<double>("low");
+    this->high = _sdf->Get<double>("high");
+    this->switchTime = this->duration / 2.0;
+    if (_sdf->HasElement("peakTime"))
+    {
+      this->switchTime = _sdf->Get<double>("peakTime");
+    }
+    if (this->switchTime <= 0 || this->switchTime > this->duration)
+    {
+      gzerr << "Dyno ramp peakTime must be within the duration\n";
+      return false;
+    }
+  }
+  else if (boost::iequals(typeName, "chirp"))
+  {
+    if (!require({"offset", "amplitude", "startFrequency", "endFrequency"}))
+    {
+      return false;
+    }
+    this->type = CHIRP;
+    this->offset = _sdf->Get<double>("offset");
+    this->amplitude = _sdf->Get<double>("amplitude");
+    this->startFrequency = _sdf->Get<double>("startFrequency");
+    this->endFrequency = _sdf->Get<double>("endFrequency");
+  }
+  else
+  {
+    gzerr << "Unknown dyno profile type " << typeName << "\n";
+    return false;
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////
+double DynoProfile::Command(const double _t) const
+{
+  switch (this->type)
+  {
+    case STEP:
+      return _t < this->switchTime ? this->low : this->high;
+    case RAMP:
+      if (_t < this->switchTime)
+      {
+        return this->low + (this->high - this->low) * _t / this->switchTime;
+      }
+      else
+      {
+        double fall = this->duration - this->switchTime;
+        double remaining = std::max(0.0, this->duration - _t);
+        return fall > 0 ?
+          this->low + (this->high - this->low) * remaining / fall : this->low;
+      }
+    case CHIRP:
+    {
+      double rate = (this->endFrequency - this->startFrequency) /
+        this->duration;
+      double phase = 2 * M_PI * (this->startFrequency * _t +
+          0.5 * rate * _t * _t);
+      return this->offset + this->amplitude * std::sin(phase);
+    }
+  }
+  return 0;
+}
+
+/////////////////////////////////////////////////
+std::string DynoProfile::Name() const
+{
+  switch (this->type)
+  {
+    case STEP:
+      return "step";
+    case RAMP:
+      return "ramp";
+    case CHIRP:
+      return "chirp";
+  }
+  return "";
+}
+
+/////////////////////////////////////////////////
+double DynoProfile::Duration() const
+{
+  return this->duration;
+}
+
+/////////////////////////////////////////////////
+bool DynoLog::Open(const std::string &_path, const bool _binary,
+    const unsigned int _numMotors)
+{
+  this->binary = _binary;
+  this->numMotors = _numMotors;
+  this->buffer.resize(1 << 20);
+  this->out.rdbuf()->pubsetbuf(this->buffer.data(), this->buffer.size());
+  this->out.open(_path, _binary ? std::ios::out | std::ios::binary :
+      std::ios::out);
+  if (!this->out)
+  {
+    gzerr << "Could not open dyno output " << _path << "\n";
+    return false;
+  }
+
+  if (this->binary)
+  {
+    uint32_t n = _numMotors;
+    this->out.write("GYMFCDYN", 8);
+    this->out.write(reinterpret_cast<const char *>(&n), sizeof(n));
+    this->record.resize(3 + 3 * _numMotors);
+  }
+  else
+  {
+    this->out << "profile,time,command";
+    for (const char *name : {"velocity", "force", "torque"})
+    {
+      for (unsigned int i = 0; i < _numMotors; i++)
+      {
+        this->out << "," << name << "_" << i;
+      }
+    }
+    this->out << "\n";
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////
+void DynoLog::Write(const uint32_t _profile, const double _time,
+    const double _command, const gymfc::msgs::State &_state)
+{
+  const google::protobuf::RepeatedField<float> *fields[3] = {
+    &_state.esc_motor_angular_velocity(), &_state.esc_force(),
+    &_state.esc_torque()};
+
+  if (this->binary)
+  {
+    memcpy(&this->record[0], &_profile, sizeof(_profile));
+    this->record[1] = _time;
+    this->record[2] = _command;
+    float *dst = &this->record[3];
+    for (auto field : fields)
+    {
+      for (unsigned int i = 0; i < this->numMotors; i++)
+      {
+        *dst++ = i < static_cast<unsigned int>(field->size()) ?
+          field->Get(i) : 0;
+      }
+    }
+    this->out.write(reinterpret_cast<const char *>(this->record.data()),
+        this->record.size() * sizeof(float));
+  }
+  else
+  {
+    this->out << _profile << "," << _time << "," << _command;
+    for (auto field : fields)
+    {
+      for (unsigned int i = 0; i < this->numMotors; i++)
+      {
+        this->out << "," << (i < static_cast<unsigned int>(field->size()) ?
+            field->Get(i) : 0);
+      }
+    }
+    this->out << "\n";
+  }
+}
+
+/////////////////////////////////////////////////
+void DynoLog::Close()
+{
+  this->out.close();
+}
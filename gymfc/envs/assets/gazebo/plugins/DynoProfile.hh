@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GAZEBO_PLUGINS_DYNOPROFILE_HH_
+#define GAZEBO_PLUGINS_DYNOPROFILE_HH_
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <sdf/sdf.hh>
+
+#include "State.pb.h"
+
+namespace gazebo
+{
+  /// \brief Throttle profile applied to every motor of the digital twin
+  // by the in-plugin dyno. Profiles are defined in the plugin SDF,
+  //
+  //  <profile type="step">  <low>, <high>, <stepTime>
+  //  <profile type="ramp">  <low>, <high>, [<peakTime>], rises linearly
+  //                         from low to high at peakTime then falls back,
+  //                         peakTime defaults to half the duration
+  //  <profile type="chirp"> <offset>, <amplitude>, <startFrequency>,
+  //                         <endFrequency>, a linear frequency sweep
+  //
+  // All profiles require a <duration> in seconds of sim time and every
+  // value listed except peakTime.
+  class DynoProfile
+  {
+    public: enum Type
+    {
+      STEP,
+      RAMP,
+      CHIRP
+    };
+
+    /// \brief Load the profile from its SDF element
+    /// \return False if the profile is missing required values
+    public: bool Load(sdf::ElementPtr _sdf);
+
+    /// \brief Throttle command at the given time since the profile started
+    public: double Command(const double _t) const;
+
+    public: std::string Name() const;
+
+    public: double Duration() const;
+
+    private: Type type = STEP;
+    private: double duration = 0;
+    private: double low = 0;
+    private: double high = 0;
+    private: double switchTime = 0;
+    private: double offset = 0;
+    private: double amplitude = 0;
+    private: double startFrequency = 0;
+    private: double endFrequency = 0;
+  };
+
+  /// \brief Streams the dyno measurements of every step to a CSV or
+  // binary file. The binary file starts with the 8 byte magic GYMFCDYN
+  // and a uint32 number of motors N, followed by records of
+  // uint32 profile index, float time, float command, float velocity[N],
+  // float force[N] and float torque[N].
+  class DynoLog
+  {
+    public: bool Open(const std::string &_path, const bool _binary,
+                const unsigned int _numMotors);
+
+    public: void Write(const uint32_t _profile, const double _time,
+                const double _command, const gymfc::msgs::State &_state);
+
+    public: void Close();
+
+    private: std::ofstream out;
+    private: bool binary = false;
+    private: unsigned int numMotors = 0;
+
+    /// \brief Reused binary record
+    private: std::vector<float> record;
+
+    /// \brief Large output buffer so the file is written in big chunks
+    private: std::vector<char> buffer;
+  };
+}
+#endif
@@ -15,10 +15,17 @@
  *
 */
 #include <iomanip>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <chrono>
+#include <thread>
+#include <type_traits>
 
 
 #include <functional>
 #include <fcntl.h>
+#include <csignal>
 #include <cstdlib>
 
 
@@ -33,6 +40,8 @@
   #include <netinet/in.h>
   #include <netinet/tcp.h>
   #include <arpa/inet.h>
+  #include <poll.h>
+  #include <unistd.h>
   using raw_type = void;
 #endif
 
@@ -59,6 +68,7 @@ typedef SSIZE_T ssize_t;
 #include "FlightControllerPlugin.hh"
 
 #include "MotorCommand.pb.h"
+#include "ParameterScale.pb.h"
 #include "EscSensor.pb.h"
 #include "Imu.pb.h"
 
@@ -107,6 +117,53 @@ bool hasEnding (std::string const &fullString, std::string const &ending) {
 
 
 
+/// \brief Bit of a sensor in the stale sensor mask, sensors past the
+/// width of the mask are not tracked
+static inline uint64_t SensorBit(const int _bit)
+{
+  return _bit < 64 ? (1ULL << _bit) : 0;
+}
+
+/// \brief Hint to the CPU that we are busy waiting
+static inline void CpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__("yield");
+#endif
+}
+
+/// \brief Return the State field filled by an enable flag of a digital
+/// twin sensor, or null if there is none. Units are those of the Gazebo
+/// sensors unless the twin overrides them with a units attribute.
+static const char * const *FindStateField(const std::string &_sensorType, const std::string &_flag)
+{
+  static const char *kFields[][4] = {
+    {"imu", "enable_angular_velocity", "imu_angular_velocity_rpy", "rad/s"},
+    {"imu", "enable_linear_acceleration", "imu_linear_acceleration_xyz", "m/s^2"},
+    {"imu", "enable_orientation", "imu_orientation_quat", "1"},
+    {"esc", "enable_angular_velocity", "esc_motor_angular_velocity", "rad/s"},
+    {"esc", "enable_temperature", "esc_temperature", "degC"},
+    {"esc", "enable_current", "esc_current", "A"},
+    {"esc", "enable_voltage", "esc_voltage", "V"},
+    {"esc", "enable_force", "esc_force", "N"},
+    {"esc", "enable_torque", "esc_torque", "N*m"},
+    {"battery", "enable_voltage", "vbat_voltage", "V"},
+    {"battery", "enable_current", "vbat_current", "A"},
+    {"battery", "enable_state_of_charge", "vbat_state_of_charge", "1"}
+  };
+  for (auto &field : kFields)
+  {
+    if (boost::iequals(_sensorType, field[0]) && _flag.compare(field[1]) == 0)
+    {
+      return field;
+    }
+  }
+  return nullptr;
+}
+
+
 using namespace gazebo;
 
 
@@ -118,6 +175,10 @@ FlightControllerPlugin::FlightControllerPlugin()
 {
   GOOGLE_PROTOBUF_VERIFY_VERSION;
 
+  this->MakeSocket();
+}
+void FlightControllerPlugin::MakeSocket()
+{
   // socket
   this->handle = socket(AF_INET, SOCK_DGRAM /*SOCK_STREAM*/, 0);
   #ifndef _WIN32
@@ -154,60 +215,111 @@ FlightControllerPlugin::~FlightControllerPlugin()
 
 void FlightControllerPlugin::Load(physics::WorldPtr _world, sdf::ElementPtr _sdf)
 {
+  common::Time loadStart = common::Time::GetWallTime();
 
   this->world = _world;
+  this->parentPid = getppid();
   this->ProcessSDF(_sdf);
 
   this->LoadVars();
 
-  this->ParseDigitalTwinSDF();
-
-  this->CalculateCallbackCount();
-
   this->nodeHandle = transport::NodePtr(new transport::Node());
   this->nodeHandle->Init(this->robotNamespace);
 
-  //Subscribe to all the sensors that are
-  //enabled
-  for (auto  sensor : this->supportedSensors)
+  if (this->digitalTwinSDF.empty())
+  {
+    // Standby, a launcher can start servers ahead of time and later assign
+    // each one an aircraft with LOAD_DIGITAL_TWIN
+    gzmsg << "No digital twin given, waiting for one to be loaded by the client.\n";
+  }
+  else
   {
-    switch(sensor)
+    common::Time parseStart = common::Time::GetWallTime();
+    if (!this->ParseDigitalTwinSDF())
     {
-      case IMU:
-        this->imuSub = this->nodeHandle->Subscribe<sensor_msgs::msgs::Imu>(this->imuSubTopic, &FlightControllerPlugin::ImuCallback, this);
-        break;
-      case ESC:
-        //Each defined motor will have a unique index, since they are indpendent they must come in 
-        //as separate messages
-        //XXX NOTE index starts at 1 to match that of betaflight mixer
-        //for (unsigned int i = 1; i <= this->numActuators; i++)
-        for (unsigned int i = 0; i < this->numActuators; i++)
-        {
-          this->escSub.push_back(this->nodeHandle->Subscribe<sensor_msgs::msgs::EscSensor>(this->escSubTopic + "/" + std::to_string(i) , &FlightControllerPlugin::EscSensorCallback, this));
-        }
-        break;
+      gzerr << "Could not parse digital twin, aborting plugin.\n";
+      return;
     }
+    this->startupTiming.parse = (common::Time::GetWallTime() - parseStart).Double();
+
+    this->CalculateCallbackCount();
+    this->SubscribeSensors();
+    this->InitState();
+    this->OpenRecorder();
+    this->OpenTelemetry();
   }
-  this->InitState();
 
   this->cmdPub = this->nodeHandle->Advertise<cmd_msgs::msgs::MotorCommand>(this->cmdPubTopic);
+  this->parameterPub = this->nodeHandle->Advertise<cmd_msgs::msgs::ParameterScale>(this->parameterPubTopic);
   // Force pause because we drive the simulation steps
   this->world->SetPaused(TRUE);
 
+  if (this->physicsPlacement.Requested())
+  {
+    this->updateConnection = event::Events::ConnectWorldUpdateBegin(
+        std::bind(&FlightControllerPlugin::OnWorldUpdateBegin, this, std::placeholders::_1));
+  }
+
+
+  this->startupTiming.load = (common::Time::GetWallTime() - loadStart).Double();
 
   this->callbackLoopThread = boost::thread( boost::bind( &FlightControllerPlugin::LoopThread, this) );
 }
-bool FlightControllerPlugin::SensorEnabled(Sensors _sensor)
+void FlightControllerPlugin::OpenRecorder()
 {
-  for (auto  sensor : this->supportedSensors)
+  if (this->recordPath.empty())
   {
-    if (sensor == _sensor)
-    {
-      return true;
-    }
+    return;
   }
-  return false;
+  if (this->replayPath.compare(this->recordPath) == 0)
+  {
+    gzerr << "Cannot record to the flight log being replayed, recording disabled.\n";
+  }
+  else if (!this->recorder.Open(this->recordPath, this->numActuators, this->recordSegmentSize))
+  {
+    gzerr << "Could not open flight log " << this->recordPath << ", recording disabled.\n";
+  }
+  // Only one log per run, a later digital twin must not overwrite it
+  this->recordPath.clear();
+}
+
+void FlightControllerPlugin::OpenTelemetry()
+{
+  if (this->telemetryName.empty() ||
+      (this->telemetry.IsOpen() && this->telemetry.NumActuators() == static_cast<uint32_t>(this->numActuators)))
+  {
+    return;
+  }
+  if (!this->telemetry.Open(this->telemetryName, this->numActuators,
+        this->telemetryStats ? TELEMETRY_STATS : TELEMETRY_SAMPLE,
+        this->telemetryDecimation, this->telemetryCapacity))
+  {
+    gzerr << "Could not open telemetry " << this->telemetryName << ", telemetry disabled.\n";
+    this->telemetryName.clear();
+  }
+}
+
+void FlightControllerPlugin::SubscribeSensors()
+{
+  // Dropping the previous subscribers unsubscribes them
+  this->sensorSubs.clear();
 
+  //Subscribe to all the sensors that are
+  //enabled
+  SensorRegistry::ForEach([this](auto _sensor, unsigned int _index)
+  {
+    typedef decltype(_sensor) S;
+    if (!this->supportedSensors[_index])
+    {
+      return;
+    }
+    for (int i = 0; i < S::Count(this->numActuators); i++)
+    {
+      this->sensorSubs.push_back(this->nodeHandle->Subscribe(
+            S::Topic(this->sensorTopics[_index], i),
+            &FlightControllerPlugin::SensorCallback<S>, this));
+    }
+  });
 }
 void FlightControllerPlugin::LoadVars()
 {
@@ -216,26 +328,86 @@ void FlightControllerPlugin::LoadVars()
   //we need to switch to a config file
 
   // Default port can be read in from an environment variable
-  // This allows multiple instances to be run
-  int port = 9002;
+  // This allows multiple instances to be run. The variable can also
+  // be 0 for any free port or a range begin-end to bind the first free
+  // port in it, the bound port is then reported through the handshake.
+  std::string portSpec = "9002";
   if(const char* env_p =  std::getenv(ENV_SITL_PORT))
   {
-		  port = std::stoi(env_p);
+		  portSpec = env_p;
+  }
+  size_t dash = portSpec.find('-');
+  int portBegin = -1;
+  int portEnd = -1;
+  try
+  {
+    portBegin = std::stoi(portSpec.substr(0, dash));
+    portEnd = dash == std::string::npos ? portBegin : std::stoi(portSpec.substr(dash + 1));
+  }
+  catch (const std::exception &)
+  {
+  }
+  // 0 alone asks for any free port, a range must lie within 1-65535
+  bool anyPort = portBegin == 0 && portEnd == 0;
+  if (!anyPort && (portBegin < 1 || portEnd > 65535 || portBegin > portEnd))
+  {
+    gzerr << "Invalid " << ENV_SITL_PORT << " " << portSpec
+      << ", expected a port, 0 or a range begin-end within 1-65535, aborting plugin.\n";
+    return;
   }
-  gzdbg << "Binding on port " << port << "\n";
-  if (!this->Bind("127.0.0.1", port))
+  gzdbg << "Binding on port " << portSpec << "\n";
+  bool bound = portBegin == portEnd && portBegin != 0 ?
+    this->Bind("127.0.0.1", portBegin) : this->BindInRange("127.0.0.1", portBegin, portEnd);
+  if (!bound)
   {
-    gzerr << "failed to bind with 127.0.0.1:" << port <<", aborting plugin.\n";
+    gzerr << "failed to bind with 127.0.0.1:" << portSpec <<", aborting plugin.\n";
     return;
   }
+  struct sockaddr_in boundAddr;
+  socklen_t boundAddrLen = sizeof(boundAddr);
+  getsockname(this->handle, (struct sockaddr *)&boundAddr, &boundAddrLen);
+  this->port = ntohs(boundAddr.sin_port);
+  gzdbg << "Bound to port " << this->port << "\n";
+
+  if(const char* env_p =  std::getenv(ENV_REPLAY_PATH))
+  {
+    this->replayPath = env_p;
+    const char* diff = std::getenv(ENV_REPLAY_DIFF);
+    this->replayDiff = diff && std::string(diff) == "1";
+  }
+
+  if(const char* env_p =  std::getenv(ENV_DYNO_OUTPUT))
+  {
+    this->dynoOutput = env_p;
+  }
+
+  // Cores differ between instances packed on the same node
+  if(const char* env_p =  std::getenv(ENV_LOOP_CPUS))
+  {
+    this->loopPlacement.SetCpus(env_p);
+  }
+  if(const char* env_p =  std::getenv(ENV_PHYSICS_CPUS))
+  {
+    this->physicsPlacement.SetCpus(env_p);
+  }
+  if(const char* env_p =  std::getenv(ENV_TRANSPORT_CPUS))
+  {
+    this->transportPlacement.SetCpus(env_p);
+  }
+
+  if(const char* env_p =  std::getenv(ENV_RECORD_PATH))
+  {
+    this->recordPath = env_p;
+  }
+
+  if(const char* env_p =  std::getenv(ENV_TELEMETRY_SHM))
+  {
+    this->telemetryName = env_p;
+  }
 
   if(const char* env_p =  std::getenv(ENV_DIGITAL_TWIN_SDF))
   {
     this->digitalTwinSDF = env_p;
-  } else 
-  {
-    gzerr << "Could not load digital twin model from environment variable " << ENV_DIGITAL_TWIN_SDF << "\n";
-    return;
   }
 
 
@@ -248,88 +420,205 @@ void FlightControllerPlugin::InitState()
 	  this->state.add_force(0);
   }
 
-  //XXX Initialize the state of the senors to a value
-  // that reflect the aircraft in an active state thus 
-  // forcing the sensors to be flushed.
-  for (unsigned int i = 0; i < 3; i++)
+  SensorRegistry::ForEach([this](auto _sensor, unsigned int)
   {
-    this->state.add_imu_angular_velocity_rpy(1);
-    // TODO 
-    this->state.add_imu_linear_acceleration_xyz(0);
-  }
-  for (unsigned int i = 0; i < 4; i++)
-  {
-    // TODO 
-    this->state.add_imu_orientation_quat(0);
-  }
-
+    decltype(_sensor)::Init(this->state, this->numActuators);
+  });
+  this->sensorState = this->state;
+}
 
-  // ESC sensor 
-  for (unsigned int i = 0; i < this->numActuators; i++)
+void FlightControllerPlugin::PlaceTransportThread()
+{
+  static thread_local bool placed = false;
+  if (!placed && this->transportPlacement.Requested())
   {
-    this->state.add_esc_motor_angular_velocity(100);
-    this->state.add_esc_temperature(10000);
-    this->state.add_esc_current(-1);
-    this->state.add_esc_voltage(-1);
-    this->state.add_esc_torque(0);
-    this->state.add_esc_force(0);
+    placed = true;
+    this->transportPlacement.Apply();
   }
-
 }
 
-void FlightControllerPlugin::EscSensorCallback(EscSensorPtr &_escSensor)
+void FlightControllerPlugin::OnWorldUpdateBegin(const common::UpdateInfo &/*_info*/)
 {
-  uint32_t id = _escSensor->id();  
-  boost::mutex::scoped_lock lock(g_CallbackMutex);
-
-  //gzdbg << "\nReceived ESC " << id << " speed=" <<  _escSensor->motor_speed() << std::endl;
-  this->state.set_esc_motor_angular_velocity(id, _escSensor->motor_speed());
-  this->state.set_esc_temperature(id, _escSensor->temperature());
-  this->state.set_esc_current(id, _escSensor->current());
-  this->state.set_esc_voltage(id, _escSensor->voltage());
-  this->state.set_esc_force(id, _escSensor->force());
-  this->state.set_esc_torque(id, _escSensor->torque());
-  this->sensorCallbackCount++;
-  this->callbackCondition.notify_all();
-
+  if (!this->physicsPlaced)
+  {
+    this->physicsPlaced = true;
+    this->physicsPlacement.Apply();
+  }
 }
-void FlightControllerPlugin::ImuCallback(ImuPtr &_imu)
+
+template <typename S>
+void FlightControllerPlugin::SensorCallback(const boost::shared_ptr<const typename S::MsgType> &_msg)
 {
-  //gzdbg << "Received IMU" << std::endl;
+  this->PlaceTransportThread();
+  int index = S::Index(*_msg);
   boost::mutex::scoped_lock lock(g_CallbackMutex);
+  // May still arrive from a digital twin that was just swapped out
+  if (index < 0 || index >= S::Capacity(this->sensorState))
+  {
+    return;
+  }
 
-  this->state.set_imu_angular_velocity_rpy(0, _imu->angular_velocity().x());
-  this->state.set_imu_angular_velocity_rpy(1, _imu->angular_velocity().y());
-  this->state.set_imu_angular_velocity_rpy(2, _imu->angular_velocity().z());
-
-  this->state.set_imu_orientation_quat(0, _imu->orientation().w());
-  this->state.set_imu_orientation_quat(1, _imu->orientation().x());
-  this->state.set_imu_orientation_quat(2, _imu->orientation().y());
-  this->state.set_imu_orientation_quat(3, _imu->orientation().z());
-
-  this->state.set_imu_linear_acceleration_xyz(0, _imu->linear_acceleration().x());
-  this->state.set_imu_linear_acceleration_xyz(1, _imu->linear_acceleration().y());
-  this->state.set_imu_linear_acceleration_xyz(2, _imu->linear_acceleration().z());
+  uint64_t bit = SensorBit(S::FirstBit() + index);
+  if (this->lateSensorMask & bit)
+  {
+    this->lateSensorMask &= ~bit;
+    return;
+  }
 
+  S::Store(this->sensorState, index, *_msg);
+  this->arrivedSensorMask |= bit;
   this->sensorCallbackCount++;
   this->callbackCondition.notify_all();
-
 }
+
 void FlightControllerPlugin::ProcessSDF(sdf::ElementPtr _sdf)
 {
   this->cmdPubTopic = kDefaultCmdPubTopic;
   if (_sdf->HasElement("commandPubTopic")){
       this->cmdPubTopic = _sdf->GetElement("commandPubTopic")->Get<std::string>();
   }
-  this->imuSubTopic = kDefaultImuSubTopic;
-  if (_sdf->HasElement("imuSubTopic")){
-      this->imuSubTopic = _sdf->GetElement("imuSubTopic")->Get<std::string>();
+  SensorRegistry::ForEach([this, &_sdf](auto _sensor, unsigned int _index)
+  {
+    typedef decltype(_sensor) S;
+    getSdfParam<std::string>(_sdf, S::TopicParam(), this->sensorTopics[_index], S::DefaultTopic());
+  });
+
+
+  getSdfParam<unsigned int>(_sdf, "recordSegmentSize", this->recordSegmentSize, 100000);
+
+  this->telemetryDecimation = 10;
+  this->telemetryCapacity = 4096;
+  this->telemetryStats = false;
+  if (_sdf->HasElement("telemetry"))
+  {
+    sdf::ElementPtr telemetrySDF = _sdf->GetElement("telemetry");
+    getSdfParam<unsigned int>(telemetrySDF, "decimation", this->telemetryDecimation, 10);
+    getSdfParam<unsigned int>(telemetrySDF, "capacity", this->telemetryCapacity, 4096);
+    getSdfParam<bool>(telemetrySDF, "stats", this->telemetryStats, false);
+  }
+
+  if (_sdf->HasElement("threadPlacement"))
+  {
+    sdf::ElementPtr placementSDF = _sdf->GetElement("threadPlacement");
+    std::pair<ThreadPlacement *, std::string> placements[] = {
+      {&this->loopPlacement, "loop"}, {&this->physicsPlacement, "physics"},
+      {&this->transportPlacement, "transport"}};
+    for (auto &placement : placements)
+    {
+      std::string cpus;
+      int priority;
+      getSdfParam<std::string>(placementSDF, placement.second + "Cpus", cpus, "");
+      getSdfParam<int>(placementSDF, placement.second + "Priority", priority, 0);
+      placement.first->SetCpus(cpus);
+      placement.first->SetPriority(priority);
+    }
+  }
+
+  this->sensorWaitStrategy = WAIT_ADAPTIVE;
+  this->sensorWaitMaxSpin = 20;
+  this->sensorWaitYield = 50;
+  if (_sdf->HasElement("sensorWait"))
+  {
+    sdf::ElementPtr waitSDF = _sdf->GetElement("sensorWait");
+    std::string strategy;
+    getSdfParam<std::string>(waitSDF, "strategy", strategy, "adaptive");
+    if (boost::iequals(strategy, "block"))
+    {
+      this->sensorWaitStrategy = WAIT_BLOCK;
+    }
+    else if (!boost::iequals(strategy, "adaptive"))
+    {
+      gzerr << "Unknown sensor wait strategy " << strategy << ", using adaptive.\n";
+    }
+    getSdfParam<double>(waitSDF, "maxSpinUs", this->sensorWaitMaxSpin, 20);
+    getSdfParam<double>(waitSDF, "yieldUs", this->sensorWaitYield, 50);
+  }
+
+  getSdfParam<double>(_sdf, "sensorTimeout", this->sensorTimeout, 0.5);
+
+  getSdfParam<double>(_sdf, "connectionTimeout", this->connectionTimeout, 1.0);
+  getSdfParam<int>(_sdf, "connectionTimeoutMaxCount", this->connectionTimeoutMaxCount, 5);
+  getSdfParam<bool>(_sdf, "exitWhenIdle", this->exitWhenIdle, false);
+  getSdfParam<bool>(_sdf, "exitWhenOrphaned", this->exitWhenOrphaned, false);
+
+  this->parameterPubTopic = kDefaultParameterPubTopic;
+  if (_sdf->HasElement("parameterPubTopic")){
+      this->parameterPubTopic = _sdf->GetElement("parameterPubTopic")->Get<std::string>();
+  }
+
+  if (_sdf->HasElement("domainRandomization"))
+  {
+    sdf::ElementPtr randomizationSDF = _sdf->GetElement("domainRandomization");
+    getSdfParam<double>(randomizationSDF, "mass", this->randomizeMass, 0);
+    getSdfParam<double>(randomizationSDF, "inertia", this->randomizeInertia, 0);
+    getSdfParam<double>(randomizationSDF, "cotOffset", this->randomizeCot, 0);
+    sdf::ElementPtr parameterSDF = randomizationSDF->GetElement("parameter");
+    while (parameterSDF)
+    {
+      this->randomizeParameters.push_back(std::make_pair(
+            parameterSDF->GetAttribute("name")->GetAsString(), parameterSDF->Get<double>()));
+      parameterSDF = parameterSDF->GetNextElement("parameter");
+    }
+  }
+
+  this->historyLength = 0;
+  this->historyActions = false;
+  if (_sdf->HasElement("history"))
+  {
+    sdf::ElementPtr historySDF = _sdf->GetElement("history");
+    getSdfParam<unsigned int>(historySDF, "length", this->historyLength, 0);
+    getSdfParam<bool>(historySDF, "actions", this->historyActions, false);
+  }
+
+  if (_sdf->HasElement("stabilityMonitor"))
+  {
+    this->stabilityMonitor.Load(_sdf->GetElement("stabilityMonitor"));
+  }
+
+  if (_sdf->HasElement("sensorNoise"))
+  {
+    this->sensorNoise.Load(_sdf->GetElement("sensorNoise"));
+  }
+
+  if (_sdf->HasElement("setpoints") &&
+      !this->setpoints.Load(_sdf->GetElement("setpoints")))
+  {
+    gzerr << "Invalid setpoints, setpoints disabled.\n";
+  }
+
+  if (_sdf->HasElement("reward"))
+  {
+    this->rewardKernel.LoadReward(_sdf->GetElement("reward"));
+  }
+  if (_sdf->HasElement("termination"))
+  {
+    this->rewardKernel.LoadTermination(_sdf->GetElement("termination"));
   }
-  this->escSubTopic = kDefaultEscSubTopic;
-  if (_sdf->HasElement("escSubTopicPrefix")){
-      this->escSubTopic = _sdf->GetElement("escSubTopicPrefix")->Get<std::string>();
+
+  getSdfParam<bool>(_sdf, "ballJointForce", this->readBallJointForce, false);
+  this->readBallJointForce |= this->rewardKernel.UsesBallJointForce();
+
+  if (_sdf->HasElement("batteryModel"))
+  {
+    this->batteryModel.Load(_sdf->GetElement("batteryModel"));
   }
 
+  if (_sdf->HasElement("dyno"))
+  {
+    sdf::ElementPtr dynoSDF = _sdf->GetElement("dyno");
+    getSdfParam<std::string>(dynoSDF, "output", this->dynoOutput, "dyno.csv");
+    getSdfParam<bool>(dynoSDF, "binary", this->dynoBinary, false);
+    sdf::ElementPtr profileSDF = dynoSDF->GetElement("profile");
+    while (profileSDF)
+    {
+      DynoProfile profile;
+      if (profile.Load(profileSDF))
+      {
+        this->dynoProfiles.push_back(profile);
+      }
+      profileSDF = profileSDF->GetNextElement("profile");
+    }
+  }
 
   if (_sdf->HasElement("robotNamespace"))
     this->robotNamespace = _sdf->GetElement("robotNamespace")->Get<std::string>();
@@ -363,7 +652,7 @@ physics::LinkPtr FlightControllerPlugin::FindLinkByName(physics::ModelPtr _model
 
 }
 
-void FlightControllerPlugin::ParseDigitalTwinSDF()
+bool FlightControllerPlugin::ParseDigitalTwinSDF()
 {
    // Load the root digital twin sdf file
   const std::string sdfPath(this->digitalTwinSDF);
@@ -374,13 +663,13 @@ void FlightControllerPlugin::ParseDigitalTwinSDF()
   if (!sdf::readFile(sdfPath, this->sdfElement))
   {
     gzerr << sdfPath << " is not a valid SDF file!" << std::endl;
-    return;
+    return false;
   }
   const sdf::ElementPtr rootElement = this->sdfElement->Root();
   if (!rootElement->HasElement("model"))
   {
     gzerr << "Could not find model!" << std::endl;
-    return;
+    return false;
   }
   this->modelElement = rootElement->GetElement("model");
 
@@ -401,6 +690,7 @@ void FlightControllerPlugin::ParseDigitalTwinSDF()
   if (!foundAircraftConfigPlugin)
   {
     gzerr << "Could not find required " << kAircraftConfigFileName << ". Aborting!" << std::endl;
+    return false;
   }
 
   const sdf::ElementPtr centerOfThrustElement = pluginPtr->GetElement("centerOfThrust");
@@ -416,53 +706,110 @@ void FlightControllerPlugin::ParseDigitalTwinSDF()
   if (!sensorsSDF)
   {
    gzerr << "Could not find any sensors\n"; 
+   return false;
   }
+  this->supportedSensors.fill(false);
+  this->enabledFields.clear();
+  this->enabledUnits.clear();
+  bool batteryDeclared = false;
   sdf::ElementPtr sensorSDF = sensorsSDF->GetElement("sensor");
   while (sensorSDF)
   {
     std::string type = sensorSDF->GetAttribute("type")->GetAsString();
+    batteryDeclared |= boost::iequals(type, BatterySensor::Name());
+
+    // Each enable flag selects a State field, in the order they are given
+    sdf::ElementPtr enableSDF = sensorSDF->GetFirstElement();
+    while (enableSDF)
+    {
+      if (enableSDF->Get<bool>())
+      {
+        const char * const *field = FindStateField(type, enableSDF->GetName());
+        if (!field)
+        {
+          gzwarn << "Sensor " << type << " " << enableSDF->GetName() << " has no state field, ignoring.\n";
+        }
+        else
+        {
+          this->enabledFields.push_back(field[2]);
+          this->enabledUnits.push_back(enableSDF->HasAttribute("units") ?
+              enableSDF->GetAttribute("units")->GetAsString() : field[3]);
+        }
+      }
+      enableSDF = enableSDF->GetNextElement();
+    }
 
-    if (boost::iequals(type, "imu"))
+    bool known = false;
+    SensorRegistry::ForEach([this, &type, &known](auto _sensor, unsigned int _index)
     {
-      this->supportedSensors.push_back(IMU);
-    } 
-    else if (boost::iequals(type, "esc"))
+      if (boost::iequals(type, decltype(_sensor)::Name()))
+      {
+        this->supportedSensors[_index] = true;
+        known = true;
+      }
+    });
+    if (!known)
     {
-      this->supportedSensors.push_back(ESC);
+      gzwarn << "Sensor " << type << " is not supported, it will not be subscribed to.\n";
     }
-    else if (boost::iequals(type, "battery"))
+    // The plugin computes the battery values itself, the twin does not
+    // need to publish them
+    if (this->batteryModel.Enabled() && boost::iequals(type, BatterySensor::Name()))
     {
-      this->supportedSensors.push_back(BATTERY);
+      SensorRegistry::ForEach([this](auto _sensor, unsigned int _index)
+      {
+        if (std::is_same<decltype(_sensor), BatterySensor>::value)
+        {
+          this->supportedSensors[_index] = false;
+        }
+      });
     }
     sensorSDF = sensorSDF->GetNextElement("sensor");
   }
 
-}
-void FlightControllerPlugin::LoadDigitalTwin()
-{
-  gzdbg << "Inserting digital twin from SDF, " << this->digitalTwinSDF << ".\n";
-
-  // XXX Better way to do this?
-  // It appears the inserted model is not available in the world
-  // right away, maybe due to the message passing that occurs?
-  // For now poll until its there in the world
-  unsigned int startModelCount = this->world->ModelCount();
-  this->world->InsertModelSDF(*this->sdfElement);
-  while (1)
+  // The modelled battery values must be observed even when the twin has no
+  // battery sensor to select them
+  if (this->batteryModel.Enabled() && !batteryDeclared)
   {
-    unsigned int modelCount = this->world->ModelCount();
-    if (modelCount >= startModelCount + 1)
+    for (const char *flag : {"enable_voltage", "enable_current", "enable_state_of_charge"})
     {
-      break;
-    } else {
-      gazebo::common::Time::MSleep(100);
+      const char * const *field = FindStateField(BatterySensor::Name(), flag);
+      this->enabledFields.push_back(field[2]);
+      this->enabledUnits.push_back(field[3]);
     }
   }
 
+  // The setpoint is part of the observation
+  if (this->setpoints.Enabled())
+  {
+    this->enabledFields.push_back("setpoint");
+    this->enabledUnits.push_back("rad/s");
+  }
+
+  this->history.Configure(this->historyLength, this->enabledFields,
+      this->historyActions, this->numActuators);
+
+  return true;
+}
+
+void FlightControllerPlugin::LoadDigitalTwin()
+{
+  gzdbg << "Inserting digital twin from SDF, " << this->digitalTwinSDF << ".\n";
+
   // start parsing model
   const std::string modelName = this->modelElement->Get<std::string>("name");
   //gzdbg << "Found " << modelName << " model!" << std::endl;
 
+  // The model is inserted by the world thread once it processes the
+  // factory message, wake up as soon as it announces the new entity
+  common::Time insertStart = common::Time::GetWallTime();
+  event::ConnectionPtr addConnection = event::Events::ConnectAddEntity(
+      std::bind(&FlightControllerPlugin::OnEntityEvent, this, std::placeholders::_1));
+  this->world->InsertModelSDF(*this->sdfElement);
+  this->WaitForModel(modelName, true);
+  addConnection.reset();
+  this->startupTiming.insertion = (common::Time::GetWallTime() - insertStart).Double();
+
   // Now get a pointer to the model
   physics::ModelPtr model = this->world->ModelByName(modelName);
   if (!model){
@@ -470,6 +817,12 @@ void FlightControllerPlugin::LoadDigitalTwin()
     return;
   }
 
+  this->digitalTwinModel = model;
+  if (this->stabilityMonitor.Enabled())
+  {
+    this->stabilityMonitor.Snapshot(model);
+  }
+
   if (this->world->Name().compare("default") != 0)
   {
       gzdbg << "Using dyno, not linking aircraft to world" << std::endl;
@@ -488,6 +841,9 @@ void FlightControllerPlugin::LoadDigitalTwin()
     gzerr << "Could not find the CoT link" << std::endl;
     return;
   }
+  this->centerOfThrustReferenceLink = centerOfThrustReferenceLink;
+
+  common::Time jointStart = common::Time::GetWallTime();
 
   // Create the ball joint to attach the aircraft too
   gazebo::physics::JointPtr joint;
@@ -528,6 +884,9 @@ void FlightControllerPlugin::LoadDigitalTwin()
     mBallConstraint = std::make_shared<dart::constraint::BallJointConstraint>(aircraftSkeleton->getBodyNode(
       centerOfThrustReferenceLink->GetName()), location);
     dartLink->DARTWorld()->getConstraintSolver()->addConstraint(mBallConstraint);
+    this->ballConstraint = mBallConstraint;
+    this->dartWorld = dartLink->DARTWorld();
+    this->ballConstraintBodyNode = aircraftSkeleton->getBodyNode(centerOfThrustReferenceLink->GetName());
   } 
   else 
   {
@@ -537,64 +896,272 @@ void FlightControllerPlugin::LoadDigitalTwin()
   }
 
   joint->Init();
+  this->startupTiming.joint = (common::Time::GetWallTime() - jointStart).Double();
   
   // This is actually great because we've removed the ground plane so there is no possible collision
   gzdbg << "Aircraft model fixed to world\n";
 }
 
-void FlightControllerPlugin::FlushSensors()
+void FlightControllerPlugin::RandomizeDigitalTwin()
 {
-  // Make sure we do a reset on the time even if sensors are within range 
-  // XXX The first episode the sensor values are set to some active value
-  // to force plugins to send action state.
+  if (!this->digitalTwinModel)
+  {
+    return;
+  }
+  if (this->action.has_seed())
+  {
+    this->randomizationGenerator.seed(this->action.seed());
+  }
+  // Put the twin back into its initial pose so the joint anchor is
+  // placed relative to where the aircraft starts
   this->SoftReset();
 
-  /* 
-  cmd_msgs::msgs::MotorCommand cmd;
-  for (unsigned int i = 0; i < this->numActuators; i++)
+  // Record the nominal values the first time so perturbations never compound
+  if (this->nominalInertials.empty())
   {
-    cmd.add_motor(0);
+    for (auto link : this->digitalTwinModel->GetLinks())
+    {
+      physics::InertialPtr inertial = link->GetInertial();
+      NominalInertial nominal;
+      nominal.link = link;
+      nominal.mass = inertial->Mass();
+      nominal.ixx = inertial->IXX();
+      nominal.iyy = inertial->IYY();
+      nominal.izz = inertial->IZZ();
+      nominal.ixy = inertial->IXY();
+      nominal.ixz = inertial->IXZ();
+      nominal.iyz = inertial->IYZ();
+      this->nominalInertials.push_back(nominal);
+    }
   }
-  this->cmdPub->Publish(cmd);
-  this->world->Step(1);
-  */
-
 
-  //TODO this must be based on the units or come up with somehting generic
-  double error = 0.017;// About 1 deg/s
-  while (1)
+  std::uniform_real_distribution<double> unit(-1.0, 1.0);
+  for (auto &nominal : this->nominalInertials)
   {
-      // Pitch and Yaw are negative
-      //gzdbg << " Size =" << this->state.imu_angular_velocity_rpy_size() << std::endl;
-      //gzdbg << "IMU [" << this->state.imu_angular_velocity_rpy(0) << "," << this->state.imu_angular_velocity_rpy(1) << "," << this->state.imu_angular_velocity_rpy(2) << "]" << std::endl;
-      if (this->state.imu_angular_velocity_rpy_size() < 2 ||
-          (
-          std::abs(this->state.imu_angular_velocity_rpy(0)) > error || 
-          std::abs(this->state.imu_angular_velocity_rpy(1)) > error || 
-          std::abs(this->state.imu_angular_velocity_rpy(2)) > error)){
-        //gzdbg << "Gyro r=" << this->state.imu_angular_velocity_rpy(0) << " p=" << this->state.imu_angular_velocity_rpy(1) << " y=" << this->state.imu_angular_velocity_rpy(2) << "\n";
-        //gzdbg << "Error too great" << std::endl;
-        //
-        // Trigger all plugins to publish their values
-        this->world->Step(1);
-        // XXX
-        //this->SoftReset();
-
-        //boost::this_thread::sleep(boost::posix_time::milliseconds(100));
-      } else {
-          //gzdbg << "Target velocity reached! r=" << rates.X() << " p=" << rates.Y() << " y=" << rates.Z() << "\n";
-        break;
-      }
+    double massScale = 1.0 + this->randomizeMass * unit(this->randomizationGenerator);
+    // Scaling the whole inertia matrix by a single factor keeps it physically valid
+    double inertiaScale = massScale * (1.0 + this->randomizeInertia * unit(this->randomizationGenerator));
+    physics::InertialPtr inertial = nominal.link->GetInertial();
+    inertial->SetMass(nominal.mass * massScale);
+    inertial->SetInertiaMatrix(nominal.ixx * inertiaScale, nominal.iyy * inertiaScale,
+        nominal.izz * inertiaScale, nominal.ixy * inertiaScale,
+        nominal.ixz * inertiaScale, nominal.iyz * inertiaScale);
+    nominal.link->UpdateMass();
   }
 
-  this->SoftReset();
-
+  if (this->randomizeCot > 0 && this->ballJoint)
+  {
+    ignition::math::Vector3d cot(
+        this->cot.X() + this->randomizeCot * unit(this->randomizationGenerator),
+        this->cot.Y() + this->randomizeCot * unit(this->randomizationGenerator),
+        this->cot.Z() + this->randomizeCot * unit(this->randomizationGenerator));
+    if (this->ballConstraint)
+    {
+      // DART constraints can not be moved, replace it instead
+      this->dartWorld->getConstraintSolver()->removeConstraint(this->ballConstraint);
+      this->ballConstraint = std::make_shared<dart::constraint::BallJointConstraint>(
+          this->ballConstraintBodyNode, Eigen::Vector3d(cot.X(), cot.Y(), cot.Z()));
+      this->dartWorld->getConstraintSolver()->addConstraint(this->ballConstraint);
+    }
+    else
+    {
+      this->ballJoint->SetAnchor(0,
+          this->centerOfThrustReferenceLink->WorldPose().CoordPositionAdd(cot));
+    }
+  }
+
+  // Motor and ESC parameters live in the digital twin's own plugins,
+  // publish scale factors for the plugins which support randomization
+  if (!this->randomizeParameters.empty())
+  {
+    cmd_msgs::msgs::ParameterScale msg;
+    for (auto &parameter : this->randomizeParameters)
+    {
+      msg.add_name(parameter.first);
+      msg.add_scale(1.0 + parameter.second * unit(this->randomizationGenerator));
+    }
+    this->parameterPub->Publish(msg);
+  }
 }
-void FlightControllerPlugin::LoopThread()
+
+void FlightControllerPlugin::UnloadDigitalTwin()
 {
+  if (this->ballConstraint)
+  {
+    this->dartWorld->getConstraintSolver()->removeConstraint(this->ballConstraint);
+    this->ballConstraint.reset();
+    this->ballConstraintBodyNode = nullptr;
+    this->dartWorld.reset();
+  }
+  if (this->ballJoint)
+  {
+    this->ballJoint->Detach();
+    this->ballJoint.reset();
+  }
+  this->ballJointForce = ignition::math::Vector3d();
 
+  const std::string modelName = this->modelElement->Get<std::string>("name");
+  this->centerOfThrustReferenceLink.reset();
+  this->digitalTwinModel.reset();
+  this->stabilityMonitor.Clear();
+  this->nominalInertials.clear();
+
+  gzdbg << "Removing digital twin " << modelName << "\n";
+  event::ConnectionPtr deleteConnection = event::Events::ConnectDeleteEntity(
+      std::bind(&FlightControllerPlugin::OnEntityEvent, this, std::placeholders::_1));
+  this->world->RemoveModel(modelName);
+  this->WaitForModel(modelName, false);
+}
+
+void FlightControllerPlugin::OnEntityEvent(const std::string &/*_name*/)
+{
+  boost::mutex::scoped_lock lock(this->entityMutex);
+  this->entityCondition.notify_all();
+}
+
+void FlightControllerPlugin::WaitForModel(const std::string &_modelName, bool _present)
+{
+  boost::mutex::scoped_lock lock(this->entityMutex);
+  while (static_cast<bool>(this->world->ModelByName(_modelName)) != _present)
+  {
+    // The entity event wakes us right away, the short timeout only covers
+    // the window between the event and the model being added to the world
+    this->entityCondition.wait_for(lock, boost::chrono::milliseconds(1));
+  }
+}
+
+bool FlightControllerPlugin::SwapDigitalTwin(const std::string &_sdfPath)
+{
+  if (this->digitalTwinModel)
+  {
+    this->UnloadDigitalTwin();
+  }
+
+  this->digitalTwinSDF = _sdfPath;
+  if (!this->ParseDigitalTwinSDF())
+  {
+    return false;
+  }
+  this->CalculateCallbackCount();
+  this->SubscribeSensors();
+  {
+    boost::mutex::scoped_lock lock(g_CallbackMutex);
+    this->state.Clear();
+    this->InitState();
+    // Nothing is owed by sensors of the new twin
+    this->lateSensorMask = 0;
+  }
+
+  // The flight log layout is fixed by the motor count it was opened with
+  if (this->recorder.IsOpen() && this->recorder.NumActuators() != static_cast<uint32_t>(this->numActuators))
+  {
+    gzwarn << "Motor count changed, stopping the flight recorder.\n";
+    this->recorder.Close();
+  }
+  this->OpenRecorder();
+  this->OpenTelemetry();
 
   this->LoadDigitalTwin();
+  return static_cast<bool>(this->digitalTwinModel);
+}
+
+void FlightControllerPlugin::ReportStartupTiming()
+{
+  this->startupTiming.reported = true;
+  gzmsg << std::fixed << std::setprecision(1)
+    << "Startup timing (ms): load=" << this->startupTiming.load * 1e3
+    << " sdf_parse=" << this->startupTiming.parse * 1e3
+    << " twin_insertion=" << this->startupTiming.insertion * 1e3
+    << " joint_creation=" << this->startupTiming.joint * 1e3
+    << " first_settle=" << this->startupTiming.settle * 1e3 << "\n"
+    << std::defaultfloat << std::setprecision(6);
+}
+
+void FlightControllerPlugin::FlushSensors()
+{
+  // Make sure we do a reset on the time even if sensors are within range 
+  // XXX The first episode the sensor values are set to some active value
+  // to force plugins to send action state.
+  this->SoftReset();
+
+  /* 
+  cmd_msgs::msgs::MotorCommand cmd;
+  for (unsigned int i = 0; i < this->numActuators; i++)
+  {
+    cmd.add_motor(0);
+  }
+  this->cmdPub->Publish(cmd);
+  this->world->Step(1);
+  */
+
+
+  //TODO this must be based on the units or come up with somehting generic
+  double error = 0.017;// About 1 deg/s
+  while (1)
+  {
+      {
+        boost::mutex::scoped_lock lock(g_CallbackMutex);
+        this->CopySensorState();
+      }
+      // Pitch and Yaw are negative
+      //gzdbg << " Size =" << this->state.imu_angular_velocity_rpy_size() << std::endl;
+      //gzdbg << "IMU [" << this->state.imu_angular_velocity_rpy(0) << "," << this->state.imu_angular_velocity_rpy(1) << "," << this->state.imu_angular_velocity_rpy(2) << "]" << std::endl;
+      if (this->state.imu_angular_velocity_rpy_size() < 2 ||
+          (
+          std::abs(this->state.imu_angular_velocity_rpy(0)) > error || 
+          std::abs(this->state.imu_angular_velocity_rpy(1)) > error || 
+          std::abs(this->state.imu_angular_velocity_rpy(2)) > error)){
+        //gzdbg << "Gyro r=" << this->state.imu_angular_velocity_rpy(0) << " p=" << this->state.imu_angular_velocity_rpy(1) << " y=" << this->state.imu_angular_velocity_rpy(2) << "\n";
+        //gzdbg << "Error too great" << std::endl;
+        //
+        // Trigger all plugins to publish their values
+        this->world->Step(1);
+        // XXX
+        //this->SoftReset();
+
+        //boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+      } else {
+          //gzdbg << "Target velocity reached! r=" << rates.X() << " p=" << rates.Y() << " y=" << rates.Z() << "\n";
+        break;
+      }
+  }
+
+  this->SoftReset();
+
+}
+void FlightControllerPlugin::LoopThread()
+{
+  if (this->loopPlacement.Requested())
+  {
+    this->loopPlacement.Apply();
+  }
+
+  if (!this->digitalTwinSDF.empty())
+  {
+    this->LoadDigitalTwin();
+  }
+  else if (!this->replayPath.empty() || !this->dynoProfiles.empty())
+  {
+    gzerr << "Replay and dyno require a digital twin, set " << ENV_DIGITAL_TWIN_SDF << ".\n";
+    return;
+  }
+
+  // Ready to serve, let the launcher know where to find us
+  this->SendHandshake();
+
+  if (!this->replayPath.empty())
+  {
+    this->Replay();
+    return;
+  }
+  if (!this->dynoProfiles.empty())
+  {
+    this->RunDyno();
+    return;
+  }
+
+  common::Time lastAction = common::Time::GetWallTime();
+  this->connectionTimeoutCount = 0;
 	while (1){
 
 		bool ac_received = this->ReceiveAction();
@@ -602,31 +1169,149 @@ void FlightControllerPlugin::LoopThread()
 
     //gzdbg << "Received?" << ac_received << std::endl;
 		if (!ac_received){
+        // Spin for the lowest latency while the client is stepping, once
+        // idle sleep in the kernel until the next action arrives
+        if ((common::Time::GetWallTime() - lastAction).Double() < this->connectionTimeout ||
+            this->WaitForAction(this->connectionTimeout))
+        {
+          continue;
+        }
+        if (this->ClientTimedOut())
+        {
+          kill(getpid(), SIGINT);
+          return;
+        }
         continue;
     }
+    if (this->connectionTimeoutMaxCount > 0 &&
+        this->connectionTimeoutCount >= this->connectionTimeoutMaxCount)
+    {
+      gzmsg << "Client back online.\n";
+    }
+    this->connectionTimeoutCount = 0;
+    lastAction = common::Time::GetWallTime();
 
-        /* XXX This is a way to get force applied to possibly use for reward   
-		 */
-        this->ballJointForce = this->ballJoint->GetForceTorque(0).body1Force;
-        //gzdbg << "Force X=" << f.X() << " Y=" << f.Y() << " Z=" << f.Z() << std::endl;
-        //ignition::math::Vector3d f2 = this->ballJoint->GetForceTorque(0).body2Force;
-        //gzdbg << "Force Body 2 X=" << f2.X() << " Y=" << f2.Y() << " Z=" << f2.Z() << std::endl;
-        
+    this->ApplyAction();
+    this->SendState();
+    this->RecordStep();
+    this->PublishTelemetry();
+	}
+}
 
+void FlightControllerPlugin::ApplyAction()
+{
+    // Only sent in reply to INFO
+    this->state.clear_info();
 
     // Handle reset command
 //  if (this->world->Name().compare("default") == 0)
  // {
+    if (this->action.world_control() == gymfc::msgs::Action::LOAD_DIGITAL_TWIN)
+    {
+      bool loaded = this->SwapDigitalTwin(this->action.digital_twin_sdf());
+      if (loaded)
+      {
+        this->FlushSensors();
+        if (this->batteryModel.Enabled())
+        {
+          this->batteryModel.Reset(this->state);
+        }
+        if (this->sensorNoise.Enabled())
+        {
+          this->sensorNoise.Reset(this->state);
+        }
+        if (this->setpoints.Enabled())
+        {
+          this->state.set_sim_time(this->world->SimTime().Double());
+          this->setpoints.Reset(this->state);
+        }
+        this->history.Reset(this->state);
+        if (this->rewardKernel.Enabled())
+        {
+          this->rewardKernel.Reset(this->state);
+        }
+        // The new twin was just snapshot by the monitor
+        if (this->stabilityMonitor.Enabled())
+        {
+          this->state.set_done(false);
+          this->state.set_termination(0);
+          this->state.set_link_drift(0);
+        }
+      }
+      this->state.set_sim_time(this->world->SimTime().Double());
+      this->state.set_status_code(loaded ? gymfc::msgs::State_StatusCode_OK : gymfc::msgs::State_StatusCode_ERROR);
+      return;
+    }
+
+    if (this->action.world_control() == gymfc::msgs::Action::INFO)
+    {
+      this->FillEnvInfo(*this->state.mutable_info());
+      this->state.set_sim_time(this->world->SimTime().Double());
+      this->state.set_status_code(gymfc::msgs::State_StatusCode_OK);
+      return;
+    }
+
+    // Nothing to step until a digital twin is loaded
+    if (!this->digitalTwinModel)
+    {
+      this->state.set_sim_time(this->world->SimTime().Double());
+      this->state.set_status_code(gymfc::msgs::State_StatusCode_ERROR);
+      return;
+    }
+
     if (this->action.world_control() == gymfc::msgs::Action::RESET)
     {
+      if (this->action.randomize())
+      {
+        this->RandomizeDigitalTwin();
+      }
       //gzdbg << " Flushing sensors..." << std::endl;
       // Block until we get respone from sensors
+      common::Time settleStart = common::Time::GetWallTime();
+      this->ballJointForce = ignition::math::Vector3d();
       this->FlushSensors();
+      if (this->batteryModel.Enabled())
+      {
+        this->batteryModel.Reset(this->state);
+      }
+      if (this->sensorNoise.Enabled())
+      {
+        if (this->action.has_seed())
+        {
+          this->sensorNoise.Seed(this->action.seed());
+        }
+        this->sensorNoise.Reset(this->state);
+      }
+      if (this->setpoints.Enabled())
+      {
+        if (this->action.has_seed())
+        {
+          this->setpoints.Seed(this->action.seed());
+        }
+        this->state.set_sim_time(this->world->SimTime().Double());
+        this->setpoints.Reset(this->state);
+      }
+      this->history.Reset(this->state);
+      if (this->rewardKernel.Enabled())
+      {
+        this->rewardKernel.Reset(this->state);
+      }
+      if (this->stabilityMonitor.Enabled())
+      {
+        this->stabilityMonitor.Reset();
+        this->state.set_done(false);
+        this->state.set_termination(0);
+        this->state.set_link_drift(0);
+      }
+      if (!this->startupTiming.reported)
+      {
+        this->startupTiming.settle = (common::Time::GetWallTime() - settleStart).Double();
+        this->ReportStartupTiming();
+      }
       //gzdbg << " Sensors flushed." << std::endl;
       this->state.set_sim_time(this->world->SimTime().Double());
       this->state.set_status_code(gymfc::msgs::State_StatusCode_OK);
-      this->SendState();
-      continue;
+      return;
     }
   //}
 
@@ -645,36 +1330,236 @@ void FlightControllerPlugin::LoopThread()
     //gzdbg << "Done publishing motor command\n";
     // Triggers other plugins to publish
     this->world->Step(1);
+    this->ReadBallJointForce();
     //gzdbg << "Waiting...\n";
-    this->WaitForSensorsThenSend();
-	}
+    this->WaitForSensors();
+    if (this->batteryModel.Enabled())
+    {
+      this->batteryModel.Update(this->state, this->world->Physics()->GetMaxStepSize());
+    }
+    // Scored on the true sensor values, before the noise is applied, and
+    // against the setpoint the agent acted on, before the setpoint of the
+    // next step replaces it
+    if (this->rewardKernel.Enabled())
+    {
+      this->rewardKernel.Evaluate(this->action, this->ballJointForce, this->state);
+    }
+    if (this->sensorNoise.Enabled())
+    {
+      this->sensorNoise.Apply(this->state, this->world->Physics()->GetMaxStepSize());
+    }
+    if (this->setpoints.Enabled())
+    {
+      this->setpoints.Update(this->state);
+    }
+    this->history.Push(this->state, this->action);
+    if (this->stabilityMonitor.Enabled())
+    {
+      if (this->stabilityMonitor.Check())
+      {
+        this->state.set_status_code(gymfc::msgs::State_StatusCode_ERROR);
+        this->state.set_done(true);
+        this->state.set_termination(this->state.termination() | kTerminationUnstable);
+      }
+      this->state.set_link_drift(this->stabilityMonitor.Drift());
+    }
 }
+
+void FlightControllerPlugin::Replay()
+{
+  FlightLogReader reader;
+  if (!reader.Open(this->replayPath))
+  {
+    gzerr << "Could not open flight log " << this->replayPath << " to replay.\n";
+    return;
+  }
+  const FlightLogLayout &layout = reader.Layout();
+  if (static_cast<int>(layout.numActuators) != this->numActuators)
+  {
+    gzerr << "Flight log has " << layout.numActuators << " actuators but the digital twin has "
+      << this->numActuators << ", aborting replay.\n";
+    return;
+  }
+  gzmsg << "Replaying " << this->replayPath << (this->replayDiff ? " with diff" : "")
+    << " on " << this->world->Physics()->GetType() << " with a max step size of "
+    << this->world->Physics()->GetMaxStepSize() << " s\n";
+
+  std::vector<uint8_t> replayed(layout.recordSize);
+  uint64_t steps = 0;
+  uint64_t resets = 0;
+  double resetTime = 0;
+  uint64_t mismatches = 0;
+  uint64_t firstMismatch = 0;
+  common::Time start = common::Time::GetWallTime();
+  while (const uint8_t *record = reader.Next())
+  {
+    layout.DecodeAction(record, this->action);
+    if (this->action.world_control() == gymfc::msgs::Action::LOAD_DIGITAL_TWIN)
+    {
+      std::string sdfPath;
+      if (!reader.DigitalTwinSdf(record, sdfPath))
+      {
+        gzerr << "Flight log has no digital twin path for the swap at step " << steps
+          << ", aborting replay.\n";
+        break;
+      }
+      this->action.set_digital_twin_sdf(sdfPath);
+    }
+    if (this->action.world_control() == gymfc::msgs::Action::RESET)
+    {
+      common::Time resetStart = common::Time::GetWallTime();
+      this->ApplyAction();
+      resetTime += (common::Time::GetWallTime() - resetStart).Double();
+      resets++;
+    }
+    else
+    {
+      this->ApplyAction();
+    }
+    this->RecordStep();
+
+    if (this->replayDiff)
+    {
+      double force[3] = {this->ballJointForce.X(), this->ballJointForce.Y(),
+        this->ballJointForce.Z()};
+      layout.Encode(steps, this->action, this->state,
+          this->world->SimTime().Double(), force, replayed.data());
+      // Everything after the step index must match bit for bit
+      if (memcmp(record + layout.simTimeOffset, replayed.data() + layout.simTimeOffset,
+            layout.recordSize - layout.simTimeOffset) != 0)
+      {
+        if (mismatches == 0)
+        {
+          firstMismatch = steps;
+        }
+        mismatches++;
+      }
+    }
+    steps++;
+  }
+  double elapsed = (common::Time::GetWallTime() - start).Double();
+
+  gzmsg << "Replayed " << steps << " steps in " << elapsed << " s ("
+    << (elapsed > 0 ? steps / elapsed : 0) << " steps/s)\n";
+  if (resets > 0)
+  {
+    // Resets settle the twin for many physics steps, report them apart so
+    // the step rate of the remaining actions is not skewed by them
+    double stepTime = elapsed - resetTime;
+    uint64_t actions = steps - resets;
+    gzmsg << "Replayed " << resets << " resets in " << resetTime << " s ("
+      << resetTime / resets * 1e3 << " ms/reset), " << actions << " actions at "
+      << (stepTime > 0 ? actions / stepTime : 0) << " steps/s\n";
+  }
+  if (this->replayDiff)
+  {
+    if (mismatches == 0)
+    {
+      gzmsg << "Replay identical to the original run\n";
+    }
+    else
+    {
+      gzmsg << "Replay diverged at step " << firstMismatch << ", "
+        << mismatches << " of " << steps << " records differ\n";
+    }
+  }
+
+  // Nothing left to do without a client, shut down the server the same
+  // way as Ctrl+C so the flight log is closed cleanly.
+  kill(getpid(), SIGINT);
+}
+
+void FlightControllerPlugin::RunDyno()
+{
+  DynoLog log;
+  if (!log.Open(this->dynoOutput, this->dynoBinary, this->numActuators))
+  {
+    return;
+  }
+
+  double stepSize = this->world->Physics()->GetMaxStepSize();
+  common::Time start = common::Time::GetWallTime();
+  unsigned int steps = 0;
+  for (unsigned int p = 0; p < this->dynoProfiles.size(); p++)
+  {
+    const DynoProfile &profile = this->dynoProfiles[p];
+    gzdbg << "Running dyno profile " << p << " (" << profile.Name() << ") for " << profile.Duration() << " s\n";
+
+    // Each profile starts from rest
+    this->action.set_world_control(gymfc::msgs::Action::RESET);
+    this->ApplyAction();
+
+    this->action.set_world_control(gymfc::msgs::Action::STEP);
+    this->action.clear_motor();
+    for (int i = 0; i < this->numActuators; i++)
+    {
+      this->action.add_motor(0);
+    }
+    // Commands are computed from the step index so profiles are sampled
+    // at exactly the physics rate
+    unsigned int profileSteps = std::ceil(profile.Duration() / stepSize);
+    for (unsigned int i = 0; i < profileSteps; i++)
+    {
+      double command = profile.Command(i * stepSize);
+      for (int m = 0; m < this->numActuators; m++)
+      {
+        this->action.set_motor(m, command);
+      }
+      this->ApplyAction();
+      log.Write(p, this->state.sim_time(), command, this->state);
+    }
+    steps += profileSteps;
+  }
+  log.Close();
+
+  double elapsed = (common::Time::GetWallTime() - start).Double();
+  gzmsg << "Dyno ran " << this->dynoProfiles.size() << " profiles, " << steps << " steps in "
+    << elapsed << " s, results written to " << this->dynoOutput << "\n";
+
+  // Shut down the server the same way as Ctrl+C
+  kill(getpid(), SIGINT);
+}
+
 void FlightControllerPlugin::ResetCallbackCount()
 {
   boost::mutex::scoped_lock lock(g_CallbackMutex);
   this->sensorCallbackCount = -1 * this->numSensorCallbacks;
+  this->arrivedSensorMask = 0;
 }
 
 void FlightControllerPlugin::CalculateCallbackCount()
 {
   // Reset the callback count, once we step the sim all the new
   // vales will be published
+  this->numSensorCallbacks = 0;
+  this->expectedSensorMask = 0;
 
-  for (auto  sensor : this->supportedSensors)
+  SensorRegistry::ForEach([this](auto _sensor, unsigned int _index)
   {
-    switch(sensor){
-      case BATTERY:
-      case IMU:
-        this->numSensorCallbacks += 1;
-        break;
-      case ESC:
-        this->numSensorCallbacks += this->numActuators;
-        break;
+    typedef decltype(_sensor) S;
+    if (!this->supportedSensors[_index])
+    {
+      return;
     }
-  }
+    this->numSensorCallbacks += S::Count(this->numActuators);
+    for (int i = 0; i < S::Count(this->numActuators); i++)
+    {
+      this->expectedSensorMask |= SensorBit(S::FirstBit() + i);
+    }
+  });
 
 } 
-void FlightControllerPlugin::WaitForSensorsThenSend()
+void FlightControllerPlugin::ReadBallJointForce()
+{
+  // The dyno does not attach the aircraft to anything
+  if (!this->readBallJointForce || !this->ballJoint)
+  {
+    return;
+  }
+  this->ballJointForce = this->ballJoint->GetForceTorque(0).body1Force;
+}
+
+void FlightControllerPlugin::WaitForSensors()
 {
   this->state.set_force(0, this->ballJointForce.X());
   this->state.set_force(1, this->ballJointForce.Y());
@@ -682,22 +1567,105 @@ void FlightControllerPlugin::WaitForSensorsThenSend()
 
   this->state.set_sim_time(this->world->SimTime().Double());
   this->state.set_status_code(gymfc::msgs::State_StatusCode_OK);
+  this->state.set_stale_sensors(0);
 
-  boost::mutex::scoped_lock lock(g_CallbackMutex);
-  while (this->sensorCallbackCount < 0)
+  auto start = std::chrono::steady_clock::now();
+
+  if (this->sensorWaitStrategy == WAIT_ADAPTIVE)
   {
-    //gzdbg << "Callback count = " << this->sensorCallbackCount << std::endl;
-    this->callbackCondition.wait(lock);
+    // Sensors usually arrive within microseconds of the step, spin for
+    // about twice the typical arrival time so the common case never pays
+    // for a futex sleep and wakeup. If they take longer than the spin
+    // limit spinning only burns the core, so go straight to blocking.
+    double spinBudget = this->sensorArrivalLatency <= this->sensorWaitMaxSpin ?
+      std::min(2 * this->sensorArrivalLatency + 1, this->sensorWaitMaxSpin) : 0;
+    double yieldBudget = spinBudget + this->sensorWaitYield;
+
+    double elapsed = 0;
+    unsigned int spins = 0;
+    while (this->sensorCallbackCount.load(std::memory_order_acquire) < 0)
+    {
+      // Only read the clock every so often, it costs more than a spin
+      if ((++spins & 63) == 0)
+      {
+        elapsed = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - start).count();
+        if (elapsed > yieldBudget)
+        {
+          break;
+        }
+      }
+      if (elapsed < spinBudget)
+      {
+        CpuRelax();
+      }
+      else
+      {
+        std::this_thread::yield();
+      }
+    }
+
+    if (!this->BlockForSensors(start))
+    {
+      return;
+    }
+
+    double latency = std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - start).count();
+    this->sensorArrivalLatency += 0.05 * (latency - this->sensorArrivalLatency);
+    return;
   }
-  /*
+
+  this->BlockForSensors(start);
+}
+
+bool FlightControllerPlugin::BlockForSensors(const std::chrono::steady_clock::time_point &_start)
+{
+  boost::mutex::scoped_lock lock(g_CallbackMutex);
+  bool complete = true;
   while (this->sensorCallbackCount < 0)
   {
-        boost::this_thread::sleep(boost::posix_time::milliseconds(1000));
+    //gzdbg << "Callback count = " << this->sensorCallbackCount << std::endl;
+    if (this->sensorTimeout <= 0)
+    {
+      this->callbackCondition.wait(lock);
+      continue;
+    }
 
+    double remaining = this->sensorTimeout - std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - _start).count();
+    if (remaining <= 0)
+    {
+      // Reply with what we have rather than leaving the client hanging
+      uint64_t stale = this->expectedSensorMask & ~this->arrivedSensorMask;
+      this->lateSensorMask |= stale;
+      this->sensorTimeoutCount++;
+      this->state.set_status_code(gymfc::msgs::State_StatusCode_ERROR);
+      this->state.set_stale_sensors(stale);
+      this->state.set_sensor_timeouts(this->sensorTimeoutCount);
+      // Rate limit, a sensor that never publishes times out every step
+      if ((this->sensorTimeoutCount & (this->sensorTimeoutCount - 1)) == 0)
+      {
+        gzwarn << "Sensors timed out at " << this->world->SimTime().Double()
+          << " s, stale sensor mask 0x" << std::hex << stale << std::dec
+          << ", " << this->sensorTimeoutCount << " timeouts so far.\n";
+      }
+      complete = false;
+      break;
+    }
+    this->callbackCondition.wait_for(lock,
+        boost::chrono::microseconds(static_cast<int64_t>(remaining * 1e6)));
   }
-  */
-  //gzdbg << "Sending state"<<std::endl;
-  this->SendState();
+  this->CopySensorState();
+  return complete;
+}
+
+void FlightControllerPlugin::CopySensorState()
+{
+  SensorRegistry::ForEach([this](auto _sensor, unsigned int)
+  {
+    decltype(_sensor)::Copy(this->state, this->sensorState);
+  });
 }
 
 bool FlightControllerPlugin::Bind(const char *_address, const uint16_t _port)
@@ -718,6 +1686,83 @@ bool FlightControllerPlugin::Bind(const char *_address, const uint16_t _port)
   return true;
 }
 
+bool FlightControllerPlugin::BindInRange(const char *_address, const uint16_t _begin, const uint16_t _end)
+{
+  if (_end < _begin)
+  {
+    return false;
+  }
+  unsigned int count = _end - _begin + 1;
+  // Start at a different port in each process so parallel launches
+  // rarely try the same ports
+  unsigned int offset = getpid() % count;
+  for (unsigned int i = 0; i < count; i++)
+  {
+    // Address reuse lets two UDP sockets bind the same port, which is
+    // exactly the collision we need bind to detect here
+    int zero = 0;
+    setsockopt(this->handle, SOL_SOCKET, SO_REUSEADDR,
+       reinterpret_cast<const char *>(&zero), sizeof(zero));
+    if (this->Bind(_address, _begin + (offset + i) % count))
+    {
+      return true;
+    }
+    // A failed bind closes the socket
+    this->MakeSocket();
+  }
+  return false;
+}
+
+void FlightControllerPlugin::SendHandshake()
+{
+  const char* env_p = std::getenv(ENV_HANDSHAKE_FD);
+  if (!env_p)
+  {
+    return;
+  }
+
+  std::ostringstream msg;
+  msg << "{\"port\": " << this->port
+    << ", \"motors\": " << this->numActuators
+    << ", \"step_size\": " << this->world->Physics()->GetMaxStepSize()
+    << ", \"fields\": [";
+  for (unsigned int i = 0; i < this->enabledFields.size(); i++)
+  {
+    msg << (i > 0 ? ", " : "") << "\"" << this->enabledFields[i] << "\"";
+  }
+  msg << "]}\n";
+
+  int fd = std::stoi(env_p);
+  std::string buf = msg.str();
+  if (write(fd, buf.data(), buf.size()) != static_cast<ssize_t>(buf.size()))
+  {
+    gzerr << "Could not write handshake to file descriptor " << fd << "\n";
+  }
+  close(fd);
+}
+
+void FlightControllerPlugin::FillEnvInfo(gymfc::msgs::State::EnvInfo &_info) const
+{
+  _info.set_motor_count(this->numActuators);
+  _info.set_step_size(this->world->Physics()->GetMaxStepSize());
+  _info.set_physics_engine(this->world->Physics()->GetType());
+  _info.clear_fields();
+  _info.clear_units();
+  for (unsigned int i = 0; i < this->enabledFields.size(); i++)
+  {
+    _info.add_fields(this->enabledFields[i]);
+    _info.add_units(this->enabledUnits[i]);
+  }
+  _info.set_history_length(this->history.Length());
+  _info.set_history_actions(this->history.Actions());
+  _info.clear_threads();
+  for (const ThreadPlacement *placement : {&this->loopPlacement,
+      &this->physicsPlacement, &this->transportPlacement})
+  {
+    placement->Fill(*_info.add_threads());
+  }
+}
+
 void FlightControllerPlugin::MakeSockAddr(const char *_address, const uint16_t _port,
   struct sockaddr_in &_sockaddr)
 {
@@ -732,6 +1777,38 @@ void FlightControllerPlugin::MakeSockAddr(const char *_address, const uint16_t _
   _sockaddr.sin_addr.s_addr = inet_addr(_address);
 }
 
+bool FlightControllerPlugin::WaitForAction(const double _timeout) const
+{
+  struct pollfd fds;
+  fds.fd = this->handle;
+  fds.events = POLLIN;
+  return poll(&fds, 1, static_cast<int>(_timeout * 1000)) > 0;
+}
+
+bool FlightControllerPlugin::ClientTimedOut()
+{
+  this->connectionTimeoutCount++;
+  if (this->connectionTimeoutMaxCount <= 0 ||
+      this->connectionTimeoutCount < this->connectionTimeoutMaxCount)
+  {
+    return false;
+  }
+
+  // Parent exited and we were adopted, nobody is left to step us
+  bool orphaned = getppid() != this->parentPid;
+  if (this->connectionTimeoutCount == this->connectionTimeoutMaxCount)
+  {
+    gzmsg << "No action received for " << this->connectionTimeoutCount * this->connectionTimeout
+      << " s, client offline" << (orphaned ? " and launcher exited" : "") << ".\n";
+  }
+  if (this->exitWhenIdle || (this->exitWhenOrphaned && orphaned))
+  {
+    gzmsg << "Shutting down idle server.\n";
+    return true;
+  }
+  return false;
+}
+
 bool FlightControllerPlugin::ReceiveAction()
 {
 
@@ -766,10 +1843,9 @@ bool FlightControllerPlugin::ReceiveAction()
 }
 
 /////////////////////////////////////////////////
-void FlightControllerPlugin::SendState() const
+void FlightControllerPlugin::SendState()
 {
-  std::string buf;
-  this->state.SerializeToString(&buf);
+  const std::string &buf = this->stateEncoder.Encode(this->state);
 
   //gzdbg << " Buf data= " << buf.data() << std::endl;
   //gzdbg << "State Buf size= " << buf.size() << std::endl;
@@ -779,5 +1855,28 @@ void FlightControllerPlugin::SendState() const
 		   (struct sockaddr *)&this->remaddr, this->remaddrlen); 
 }
 
+/////////////////////////////////////////////////
+void FlightControllerPlugin::RecordStep()
+{
+  if (!this->recorder.IsOpen())
+  {
+    return;
+  }
+  double force[3] = {this->ballJointForce.X(), this->ballJointForce.Y(),
+    this->ballJointForce.Z()};
+  this->recorder.Record(this->action, this->state,
+      this->world->SimTime().Double(), force);
+}
 
-
+/////////////////////////////////////////////////
+void FlightControllerPlugin::PublishTelemetry()
+{
+  if (!this->telemetry.IsOpen())
+  {
+    return;
+  }
+  double force[3] = {this->ballJointForce.X(), this->ballJointForce.Y(),
+    this->ballJointForce.Z()};
+  this->telemetry.Publish(this->telemetrySteps++, this->action, this->state,
+      this->world->SimTime().Double(), force);
+}
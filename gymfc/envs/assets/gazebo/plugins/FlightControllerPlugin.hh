@@ -27,42 +27,57 @@
 
 #include <gazebo/physics/Base.hh>
 #include "gazebo/transport/transport.hh"
+#include <gazebo/physics/dart/dart_inc.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <sys/types.h>
 
 #include "MotorCommand.pb.h"
+#include "ParameterScale.pb.h"
 #include "EscSensor.pb.h"
 #include "Imu.pb.h"
 #include "State.pb.h"
 #include "Action.pb.h"
 
+#include "BatteryModel.hh"
+#include "DynoProfile.hh"
+#include "FlightRecorder.hh"
+#include "ObservationHistory.hh"
+#include "RewardKernel.hh"
+#include "SensorNoise.hh"
+#include "SensorRegistry.hh"
+#include "SetpointGenerator.hh"
+#include "StabilityMonitor.hh"
+#include "StateEncoder.hh"
+#include "TelemetryTap.hh"
+#include "ThreadPlacement.hh"
+
 #define ENV_SITL_PORT "GYMFC_SITL_PORT"
 #define ENV_DIGITAL_TWIN_SDF "GYMFC_DIGITAL_TWIN_SDF"
 #define ENV_NUM_MOTORS "GYMFC_NUM_MOTORS"
 #define ENV_SUPPORTED_SENSORS "GYMFC_SUPPORTED_SENSORS"
+#define ENV_RECORD_PATH "GYMFC_RECORD_PATH"
+#define ENV_REPLAY_PATH "GYMFC_REPLAY_PATH"
+#define ENV_REPLAY_DIFF "GYMFC_REPLAY_DIFF"
+#define ENV_DYNO_OUTPUT "GYMFC_DYNO_OUTPUT"
+#define ENV_HANDSHAKE_FD "GYMFC_HANDSHAKE_FD"
+#define ENV_LOOP_CPUS "GYMFC_LOOP_CPUS"
+#define ENV_PHYSICS_CPUS "GYMFC_PHYSICS_CPUS"
+#define ENV_TRANSPORT_CPUS "GYMFC_TRANSPORT_CPUS"
+#define ENV_TELEMETRY_SHM "GYMFC_TELEMETRY_SHM"
 
 namespace gazebo
 {
   static const std::string kDefaultCmdPubTopic = "/aircraft/command/motor";
-  static const std::string kDefaultImuSubTopic = "/aircraft/sensor/imu";
-  static const std::string kDefaultEscSubTopic = "/aircraft/sensor/esc";
+  static const std::string kDefaultParameterPubTopic = "/aircraft/config/parameters";
  // TODO Change link name to CoM
   const std::string DIGITAL_TWIN_ATTACH_LINK = "base_link";
   const std::string kTrainingRigModelName = "attitude_control_training_rig";
 
   const std::string kAircraftConfigFileName = "libAircraftConfigPlugin.so";
 
-  typedef const boost::shared_ptr<const sensor_msgs::msgs::Imu> ImuPtr;
-  typedef const boost::shared_ptr<const sensor_msgs::msgs::EscSensor> EscSensorPtr;
-
-  /// \brief List of all supported sensors. The client must
-  // tell us which ones it will use. The client must be aware of the 
-  // digitial twin they are using and that it supports the corresponding 
-  // sensors.
-  enum Sensors {
-    IMU,
-    ESC,
-    BATTERY
-  };
-
 class FlightControllerPlugin : public WorldPlugin
 {
   /// \brief Constructor.
@@ -83,7 +98,39 @@ class FlightControllerPlugin : public WorldPlugin
   // specified by the environment variable.
   private: void LoadDigitalTwin();
 
-  private: void ParseDigitalTwinSDF();
+  /// \brief Parse the motor count, sensors and CoT from the digital 
+  // twin SDF file
+  /// \return False if the SDF is not a valid digital twin
+  private: bool ParseDigitalTwinSDF();
+
+  /// \brief Remove the digital twin and its ball joint from the world
+  private: void UnloadDigitalTwin();
+
+  /// \brief Replace the current digital twin with the one at the given 
+  // path, resubscribing to its sensors and resizing the state
+  /// \return True if the new digital twin was inserted
+  private: bool SwapDigitalTwin(const std::string &_sdfPath);
+
+  /// \brief Subscribe to the topics of every supported sensor of the 
+  // digital twin, dropping any previous subscriptions
+  private: void SubscribeSensors();
+
+  /// \brief Start the flight recorder if a record path was given and 
+  // it has not been started yet
+  private: void OpenRecorder();
+
+  /// \brief Start the telemetry tap if a shared memory name was given,
+  // recreating it when the motor count changed
+  private: void OpenTelemetry();
+
+  /// \brief Wakes up WaitForModel when the world adds or removes an entity
+  private: void OnEntityEvent(const std::string &_name);
+
+  /// \brief Block until the model is present in (or absent from) the world
+  private: void WaitForModel(const std::string &_modelName, bool _present);
+
+  /// \brief Log how long each startup stage took
+  private: void ReportStartupTiming();
 
   /// \brief Main loop thread waiting for incoming UDP packets
 	public: void LoopThread();
@@ -91,18 +138,47 @@ class FlightControllerPlugin : public WorldPlugin
   /// \brief Bind to the specified port to receive UDP packets
 	public: bool Bind(const char *_address, const uint16_t _port);
 
+  /// \brief Bind to the first free port in the inclusive range, a range 
+  // of 0 to 0 binds any free port
+	public: bool BindInRange(const char *_address, const uint16_t _begin, const uint16_t _end);
+
+  /// \brief Create the non-blocking UDP socket
+  private: void MakeSocket();
+
+  /// \brief Write the bound port and the layout of the digital twin as a 
+  // single JSON line to the file descriptor inherited from the launcher
+  private: void SendHandshake();
+
+  /// \brief Describe the loaded digital twin and world in reply to INFO
+  private: void FillEnvInfo(gymfc::msgs::State::EnvInfo &_info) const;
+
   /// \brief Helper to make a socket
   public: void MakeSockAddr(const char *_address, const uint16_t _port, struct sockaddr_in &_sockaddr);
 
   /// \brief Receive action including motor commands 
   private: bool ReceiveAction();
 
+  /// \brief Block until an action can be received
+  /// \return False if the timeout expired first
+  private: bool WaitForAction(const double _timeout) const;
+
+  /// \brief Count a connection timeout
+  /// \return True if the server should shut down
+  private: bool ClientTimedOut();
+
   /// \brief Initialize a single protobuf state that is 
   // reused throughout the simulation.
   private: void InitState();
 
   /// \brief Send current state  
-  private: void SendState() const;
+  private: void SendState();
+
+  /// \brief Append the last action and resulting state to the flight
+  // log if recording is enabled
+  private: void RecordStep();
+
+  /// \brief Hand the last step to the telemetry tap if it is open
+  private: void PublishTelemetry();
 
   /// \brief Reset the world time and model, differs from 
   // world reset such that the random number generator is not 
@@ -110,12 +186,17 @@ class FlightControllerPlugin : public WorldPlugin
 	private: void SoftReset();
 
 
-  /// \brief Callback from the digital twin to recieve ESC sensor values
-  // where each ESC/motor will be a separate message
-  private: void EscSensorCallback(EscSensorPtr &_escSensor);
+  /// \brief Callback from the digital twin to recieve the values of a 
+  // sensor instance, S is a descriptor from SensorRegistry
+  private: template <typename S>
+           void SensorCallback(const boost::shared_ptr<const typename S::MsgType> &_msg);
+
+  /// \brief Apply the transport placement the first time a transport
+  // thread delivers a sensor message
+  private: void PlaceTransportThread();
 
-  /// \brief Callback from the digital twin to recieve IMU values
-  private: void ImuCallback(ImuPtr &_imu);
+  /// \brief Apply the physics placement from the physics thread
+  private: void OnWorldUpdateBegin(const common::UpdateInfo &_info);
 
   private: void CalculateCallbackCount();
   private: void ResetCallbackCount();
@@ -131,9 +212,37 @@ class FlightControllerPlugin : public WorldPlugin
 
   /// \brief Block until all the callbacks for the supported sneors
   // are recieved. 
-  private: void WaitForSensorsThenSend();
+  private: void WaitForSensors();
+
+  /// \brief Read the force on the ball joint during the last step, if
+  // requested and the aircraft is attached to one
+  private: void ReadBallJointForce();
+
+  /// \brief Block until all sensors arrived or the sensor timeout since
+  // _start expired, in which case the state is marked as an error
+  /// \return True if all sensors arrived
+  private: bool BlockForSensors(const std::chrono::steady_clock::time_point &_start);
+
+  /// \brief Copy the sensor values of sensorState into state, the
+  // caller must hold g_CallbackMutex
+  private: void CopySensorState();
+
+  /// \brief Step or reset the world as requested by the current action,
+  // once returned the state reflects the result
+  private: void ApplyAction();
+
+  /// \brief Apply every action of a recorded flight log as fast as 
+  // possible without a client and then shut down the server
+  private: void Replay();
+
+  /// \brief Run every dyno profile back to back at the physics rate,
+  // streaming the motor measurements to the dyno output and then shut
+  // down the server
+  private: void RunDyno();
 
-  private: bool SensorEnabled(Sensors _sensor);
+  /// \brief Perturb the physical parameters of the digital twin within
+  // the configured ranges, applied directly to the loaded model
+  private: void RandomizeDigitalTwin();
 
   private: std::string robotNamespace;
 
@@ -159,19 +268,37 @@ class FlightControllerPlugin : public WorldPlugin
 
 	public: socklen_t remaddrlen;
 
-	/// \brief number of times ArduCotper skips update
+  /// \brief Port the socket is bound to
+  public: uint16_t port = 0;
+
+	/// \brief number of consecutive connection timeouts without an action
 	public: int connectionTimeoutCount;
 
-	/// \brief number of times ArduCotper skips update
-	/// before marking Quadcopter offline
+	/// \brief number of connection timeouts before marking the client
+	/// offline, 0 never marks it offline
 	public: int connectionTimeoutMaxCount;
 
+  /// \brief Seconds without an action before the server stops spinning
+  // and blocks, also the length of a single connection timeout
+  private: double connectionTimeout;
+
+  /// \brief Shut down once the client is offline
+  private: bool exitWhenIdle;
+
+  /// \brief Shut down once the client is offline and the process that
+  // launched the server has exited
+  private: bool exitWhenOrphaned;
+
+  /// \brief Process that launched the server
+  private: pid_t parentPid;
+
   /// \brief File path to the digital twin SDF
   private: std::string digitalTwinSDF;
 
   private: std::string cmdPubTopic;
-  private: std::string imuSubTopic;
-  private: std::string escSubTopic;
+
+  /// \brief Topic of each sensor, indexed like SensorRegistry
+  private: std::array<std::string, SensorRegistry::kSize> sensorTopics;
   private: transport::NodePtr nodeHandle;
   // Now define the communication channels with the digital twin
   // The architecure treats this world plugin as the flight controller
@@ -179,22 +306,84 @@ class FlightControllerPlugin : public WorldPlugin
   // over protobufs
   private: transport::PublisherPtr cmdPub;
 
+  /// \brief Publishes randomized motor and ESC parameter scale factors
+  // to the digital twin plugins
+  private: std::string parameterPubTopic;
+  private: transport::PublisherPtr parameterPub;
+
    // Subscribe to all possible sensors
-  private: transport::SubscriberPtr imuSub;
-  private: std::vector<transport::SubscriberPtr> escSub;
+  private: std::vector<transport::SubscriberPtr> sensorSubs;
   private: cmd_msgs::msgs::MotorCommand cmdMsg;
 
   /// \brief Current callback count incremented as sensors are pbulished
-  private: int sensorCallbackCount;
+  private: std::atomic<int> sensorCallbackCount;
   private: int numSensorCallbacks;
 
+  /// \brief Sensors subscribed to and those that published since the
+  // last step, bit FirstBit() + i for instance i of each descriptor in
+  // SensorRegistry.hh, such as ImuSensor
+  private: uint64_t expectedSensorMask = 0;
+  private: uint64_t arrivedSensorMask = 0;
+
+  /// \brief Sensors that timed out and still owe the message of that
+  // step. Messages of a topic arrive in order, so the next message of
+  // such a sensor is the late one and is dropped rather than counted
+  // toward the following step.
+  private: uint64_t lateSensorMask = 0;
+
+  /// \brief Wall clock seconds to wait for the sensors after a step,
+  // 0 waits forever
+  private: double sensorTimeout;
+
+  /// \brief Number of steps the sensors timed out
+  private: uint64_t sensorTimeoutCount = 0;
+
+  /// \brief How the loop waits for the sensors after a step
+  private: enum SensorWaitStrategy
+  {
+    /// \brief Always block on the callback condition
+    WAIT_BLOCK,
+    /// \brief Spin on the callback count, then yield, then block
+    WAIT_ADAPTIVE
+  };
+  private: SensorWaitStrategy sensorWaitStrategy;
+
+  /// \brief Upper bound of the adaptive spin budget in microseconds
+  private: double sensorWaitMaxSpin;
+
+  /// \brief Microseconds to yield after spinning before blocking
+  private: double sensorWaitYield;
+
+  /// \brief Moving average of the time from the step until all sensors
+  // arrived in microseconds, used to size the spin budget
+  private: double sensorArrivalLatency = 0;
+
   private: boost::condition_variable callbackCondition;
 
   private: gymfc::msgs::State state;
+
+  /// \brief Latest values received from the sensors, only accessed with
+  // g_CallbackMutex held. They are copied into state once a step is
+  // complete, so noise and models applied to state never feed back into
+  // them and late callbacks never write the state being sent.
+  private: gymfc::msgs::State sensorState;
   private: gymfc::msgs::Action action;
-  private: std::vector<Sensors> supportedSensors;
 
-  private: int numActuators;
+  /// \brief Patches the encoded state in place instead of serializing it
+  // again every step
+  private: StateEncoder stateEncoder;
+
+  /// \brief Sensors the digital twin has, indexed like SensorRegistry
+  private: std::array<bool, SensorRegistry::kSize> supportedSensors;
+
+  private: int numActuators = 0;
+
+  /// \brief State fields enabled by the digital twin sensors, in the 
+  // order the client flattens them
+  private: std::vector<std::string> enabledFields;
+
+  /// \brief Units of each of the enabled fields
+  private: std::vector<std::string> enabledUnits;
   private: sdf::SDFPtr sdfElement;
   private: std::string centerOfThrustReferenceLinkName; 
   private: ignition::math::Vector3d cot;
@@ -203,6 +392,117 @@ class FlightControllerPlugin : public WorldPlugin
 
   private: gazebo::physics::JointPtr ballJoint;
   private: ignition::math::Vector3d ballJointForce;
+
+  /// \brief Query the ball joint wrench after every step, set by the
+  // ballJointForce element or a reward term that needs it
+  private: bool readBallJointForce = false;
+
+  /// \brief Records every step when a path prefix is provided
+  // through the environment
+  private: FlightRecorder recorder;
+  private: std::string recordPath;
+
+  /// \brief Number of records in each flight log segment file
+  private: unsigned int recordSegmentSize;
+
+  /// \brief Decimated steps published to shared memory when a name is
+  // provided through the environment
+  private: TelemetryTap telemetry;
+  private: std::string telemetryName;
+  private: unsigned int telemetryDecimation;
+  private: unsigned int telemetryCapacity;
+  private: bool telemetryStats;
+  private: uint64_t telemetrySteps = 0;
+
+  /// \brief Flight log to replay instead of serving a client
+  private: std::string replayPath;
+
+  /// \brief Compare every replayed record against the original 
+  private: bool replayDiff = false;
+
+  /// \brief Throttle profiles run by the dyno, empty unless a dyno
+  // element is given in the plugin SDF
+  private: std::vector<DynoProfile> dynoProfiles;
+
+  /// \brief Battery pack integrated from the ESC currents, replacing the
+  // battery sensor of the digital twin when configured
+  private: BatteryModel batteryModel;
+
+  /// \brief Frames of the enabled fields returned with every step
+  private: ObservationHistory history;
+  private: unsigned int historyLength;
+  private: bool historyActions;
+
+  /// \brief Reward and termination of each step, computed when a reward
+  // or termination element is given in the plugin SDF
+  private: RewardKernel rewardKernel;
+
+  /// \brief Rate setpoints of each step, generated when a setpoints
+  // element is given in the plugin SDF
+  private: SetpointGenerator setpoints;
+
+  /// \brief Noise applied to the sensor values of each step, when a
+  // sensorNoise element is given in the plugin SDF
+  private: SensorNoise sensorNoise;
+
+  /// \brief Flags the twin as unstable when its links drift apart, when
+  // a stabilityMonitor element is given in the plugin SDF
+  private: StabilityMonitor stabilityMonitor;
+  private: std::string dynoOutput;
+  private: bool dynoBinary;
+
+  /// \brief Inertial properties of a link as loaded from the SDF
+  private: struct NominalInertial
+  {
+    physics::LinkPtr link;
+    double mass, ixx, iyy, izz, ixy, ixz, iyz;
+  };
+
+  private: physics::ModelPtr digitalTwinModel;
+  private: physics::LinkPtr centerOfThrustReferenceLink;
+
+  /// \brief Constraint keeping the aircraft on the pivot when using DART
+  private: dart::constraint::BallJointConstraintPtr ballConstraint;
+  private: dart::dynamics::BodyNode* ballConstraintBodyNode = nullptr;
+  private: dart::simulation::WorldPtr dartWorld;
+
+  /// \brief Ranges of the domain randomization, mass and inertia are
+  // relative, the CoT offset is in meters per axis and the twin
+  // parameters are relative scale factors by name
+  private: double randomizeMass = 0;
+  private: double randomizeInertia = 0;
+  private: double randomizeCot = 0;
+  private: std::vector<std::pair<std::string, double>> randomizeParameters;
+  private: std::vector<NominalInertial> nominalInertials;
+  private: std::mt19937 randomizationGenerator;
+
+  private: boost::mutex entityMutex;
+  private: boost::condition_variable entityCondition;
+
+  /// \brief Wall time in seconds spent in each startup stage, reported
+  // once the first reset completes
+  private: struct StartupTiming
+  {
+    double load = 0;
+    double parse = 0;
+    double insertion = 0;
+    double joint = 0;
+    double settle = 0;
+    bool reported = false;
+  };
+  private: StartupTiming startupTiming;
+
+  /// \brief Placement of the thread serving the client
+  private: ThreadPlacement loopPlacement{"loop"};
+
+  /// \brief Placement of the Gazebo thread stepping the physics
+  private: ThreadPlacement physicsPlacement{"physics"};
+
+  /// \brief Placement of the Gazebo transport threads delivering sensors
+  private: ThreadPlacement transportPlacement{"transport"};
+
+  /// \brief Only set from the physics thread
+  private: bool physicsPlaced = false;
   };
 }
 #endif
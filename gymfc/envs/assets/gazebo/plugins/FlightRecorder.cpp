@@ -0,0 +1,560 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include <gazebo/common/common.hh>
+
+#include "FlightRecorder.hh"
+
+using namespace gazebo;
+
+/// \brief Copy a repeated field into the record, zero filling any
+/// values the state does not have.
+static uint8_t *CopyField(uint8_t *_dst,
+    const google::protobuf::RepeatedField<float> &_src, const uint32_t _n)
+{
+  float *dst = reinterpret_cast<float *>(_dst);
+  uint32_t available = std::min(static_cast<uint32_t>(_src.size()), _n);
+  if (available > 0)
+  {
+    memcpy(dst, _src.data(), available * sizeof(float));
+  }
+  for (uint32_t i = available; i < _n; i++)
+  {
+    dst[i] = 0;
+  }
+  return _dst + _n * sizeof(float);
+}
+
+/////////////////////////////////////////////////
+FlightLogLayout::FlightLogLayout(const uint32_t _numActuators)
+  : numActuators(_numActuators)
+{
+  this->stepOffset = 0;
+  this->simTimeOffset = this->stepOffset + sizeof(uint64_t);
+  this->worldControlOffset = this->simTimeOffset + sizeof(double);
+  this->statusCodeOffset = this->worldControlOffset + sizeof(uint32_t);
+  this->flagsOffset = this->statusCodeOffset + sizeof(uint32_t);
+  this->doneOffset = this->flagsOffset + 2 * sizeof(uint32_t);
+  this->motorOffset = this->doneOffset + 2 * sizeof(uint32_t);
+  this->targetRateOffset = this->motorOffset + _numActuators * sizeof(float);
+  this->stateOffset = this->targetRateOffset + 3 * sizeof(float);
+  // IMU (3 + 3 + 4), six ESC values per actuator, the battery, the
+  // setpoint, the reward and the link drift
+  this->stateSize = (10 + 6 * _numActuators + 3 + 3 + 2) * sizeof(float);
+  this->forceOffset = this->stateOffset + this->stateSize;
+  this->recordSize = this->forceOffset + 3 * sizeof(double);
+  this->recordSize = (this->recordSize + 7) & ~7u;
+}
+
+/////////////////////////////////////////////////
+void FlightLogLayout::Encode(const uint64_t _step,
+    const gymfc::msgs::Action &_action, const gymfc::msgs::State &_state,
+    const double _simTime, const double _force[3], uint8_t *_record) const
+{
+  const uint32_t n = this->numActuators;
+  uint32_t worldControl = _action.world_control();
+  uint32_t statusCode = _state.status_code();
+  memcpy(_record + this->stepOffset, &_step, sizeof(_step));
+  memcpy(_record + this->simTimeOffset, &_simTime, sizeof(_simTime));
+  memcpy(_record + this->worldControlOffset, &worldControl,
+      sizeof(worldControl));
+  memcpy(_record + this->statusCodeOffset, &statusCode, sizeof(statusCode));
+  uint32_t flags[2] = {
+    (_action.randomize() ? kFlightLogRandomize : 0u) |
+      (_action.has_seed() ? kFlightLogSeed : 0u) |
+      (_action.target_rate_size() > 0 ? kFlightLogTargetRate : 0u),
+    _action.seed()};
+  memcpy(_record + this->flagsOffset, flags, sizeof(flags));
+  uint32_t done[2] = {_state.done(), _state.termination()};
+  memcpy(_record + this->doneOffset, done, sizeof(done));
+  CopyField(_record + this->motorOffset, _action.motor(), n);
+  CopyField(_record + this->targetRateOffset, _action.target_rate(), 3);
+
+  uint8_t *dst = _record + this->stateOffset;
+  dst = CopyField(dst, _state.imu_angular_velocity_rpy(), 3);
+  dst = CopyField(dst, _state.imu_linear_acceleration_xyz(), 3);
+  dst = CopyField(dst, _state.imu_orientation_quat(), 4);
+  dst = CopyField(dst, _state.esc_motor_angular_velocity(), n);
+  dst = CopyField(dst, _state.esc_temperature(), n);
+  dst = CopyField(dst, _state.esc_current(), n);
+  dst = CopyField(dst, _state.esc_voltage(), n);
+  dst = CopyField(dst, _state.esc_force(), n);
+  dst = CopyField(dst, _state.esc_torque(), n);
+  float battery[3] = {_state.vbat_voltage(), _state.vbat_current(),
+    _state.vbat_state_of_charge()};
+  memcpy(dst, battery, sizeof(battery));
+  dst = CopyField(dst + sizeof(battery), _state.setpoint(), 3);
+  float stability[2] = {_state.reward(), _state.link_drift()};
+  memcpy(dst, stability, sizeof(stability));
+  memcpy(_record + this->forceOffset, _force, 3 * sizeof(double));
+
+  // Zero the padding so records can be compared byte for byte
+  uint32_t end = this->forceOffset + 3 * sizeof(double);
+  memset(_record + end, 0, this->recordSize - end);
+}
+
+/////////////////////////////////////////////////
+void FlightLogLayout::DecodeAction(const uint8_t *_record,
+    gymfc::msgs::Action &_action) const
+{
+  uint32_t worldControl;
+  memcpy(&worldControl, _record + this->worldControlOffset,
+      sizeof(worldControl));
+  _action.set_world_control(
+      static_cast<gymfc::msgs::Action::WorldControl>(worldControl));
+
+  uint32_t flags[2];
+  memcpy(flags, _record + this->flagsOffset, sizeof(flags));
+  _action.set_randomize(flags[0] & kFlightLogRandomize);
+  if (flags[0] & kFlightLogSeed)
+  {
+    _action.set_seed(flags[1]);
+  }
+  else
+  {
+    _action.clear_seed();
+  }
+
+  const float *motor =
+    reinterpret_cast<const float *>(_record + this->motorOffset);
+  _action.clear_motor();
+  for (uint32_t i = 0; i < this->numActuators; i++)
+  {
+    float value;
+    memcpy(&value, motor + i, sizeof(value));
+    _action.add_motor(value);
+  }
+
+  _action.clear_target_rate();
+  if (flags[0] & kFlightLogTargetRate)
+  {
+    float targetRate[3];
+    memcpy(targetRate, _record + this->targetRateOffset, sizeof(targetRate));
+    for (float value : targetRate)
+    {
+      _action.add_target_rate(value);
+    }
+  }
+}
+
+/////////////////////////////////////////////////
+FlightRecorder::FlightRecorder()
+  : segmentRecords(0), count(0), running(false), failed(false)
+{
+}
+
+/////////////////////////////////////////////////
+FlightRecorder::~FlightRecorder()
+{
+  this->Close();
+}
+
+/////////////////////////////////////////////////
+bool FlightRecorder::Open(const std::string &_prefix,
+    const uint32_t _numActuators, const uint64_t _segmentRecords)
+{
+  // A segment must hold at least one record past its header
+  if (_segmentRecords == 0)
+  {
+    gzerr << "Flight log segments must hold at least one record\n";
+    return false;
+  }
+  this->prefix = _prefix;
+  this->layout = FlightLogLayout(_numActuators);
+  this->segmentRecords = _segmentRecords;
+  this->count = 0;
+  this->failed = false;
+  // Paths of a previous log with the same prefix must not be replayed
+  std::remove((_prefix + ".twins").c_str());
+
+  if (!this->CreateSegment(0, this->current) ||
+      !this->CreateSegment(1, this->spare))
+  {
+    this->ReleaseSegment(this->current, true);
+    return false;
+  }
+
+  this->running = true;
+  this->flushThread = std::thread(&FlightRecorder::FlushThread, this);
+  gzdbg << "Recording flight log to " << _prefix << ", record size "
+    << this->layout.recordSize << " bytes\n";
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool FlightRecorder::IsOpen() const
+{
+  return this->running && !this->failed;
+}
+
+/////////////////////////////////////////////////
+uint64_t FlightRecorder::Count() const
+{
+  return this->count;
+}
+
+/////////////////////////////////////////////////
+uint32_t FlightRecorder::NumActuators() const
+{
+  return this->layout.numActuators;
+}
+
+/////////////////////////////////////////////////
+void FlightRecorder::Close()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (!this->running)
+    {
+      return;
+    }
+    this->running = false;
+  }
+  this->flushCondition.notify_all();
+  this->spareCondition.notify_all();
+  this->flushThread.join();
+
+  for (auto &segment : this->retired)
+  {
+    this->ReleaseSegment(segment, false);
+  }
+  this->retired.clear();
+  this->ReleaseSegment(this->current, false);
+  // The spare was never written to
+  this->ReleaseSegment(this->spare, true);
+  if (this->twins.is_open())
+  {
+    this->twins.close();
+  }
+  gzdbg << "Flight log closed after " << this->count << " records\n";
+}
+
+/////////////////////////////////////////////////
+bool FlightRecorder::CreateSegment(const uint32_t _index, Segment &_segment)
+{
+  std::string path = this->prefix + "." + std::to_string(_index);
+  size_t size = sizeof(FlightLogHeader) +
+    this->segmentRecords * this->layout.recordSize;
+
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0)
+  {
+    gzerr << "Could not create flight log segment " << path << "\n";
+    return false;
+  }
+  // Reserve the blocks now so the step thread never triggers allocation
+  // when it first touches a page
+  if (posix_fallocate(fd, 0, size) != 0)
+  {
+    gzerr << "Could not allocate " << size << " bytes for " << path << "\n";
+    close(fd);
+    return false;
+  }
+  void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, fd, 0);
+  if (data == MAP_FAILED)
+  {
+    gzerr << "Could not map flight log segment " << path << "\n";
+    close(fd);
+    return false;
+  }
+
+  _segment.fd = fd;
+  _segment.data = static_cast<uint8_t *>(data);
+  _segment.size = size;
+  _segment.index = _index;
+
+  FlightLogHeader *header = _segment.Header();
+  memset(header, 0, sizeof(FlightLogHeader));
+  memcpy(header->magic, kFlightLogMagic, sizeof(kFlightLogMagic));
+  header->version = kFlightLogVersion;
+  header->numActuators = this->layout.numActuators;
+  header->recordSize = this->layout.recordSize;
+  header->segmentIndex = _index;
+  header->capacity = this->segmentRecords;
+  header->count = 0;
+  return true;
+}
+
+/////////////////////////////////////////////////
+void FlightRecorder::ReleaseSegment(Segment &_segment, const bool _remove)
+{
+  if (!_segment.data)
+  {
+    return;
+  }
+  msync(_segment.data, _segment.size, MS_SYNC);
+  munmap(_segment.data, _segment.size);
+  close(_segment.fd);
+  if (_remove)
+  {
+    unlink((this->prefix + "." + std::to_string(_segment.index)).c_str());
+  }
+  _segment = Segment();
+}
+
+/////////////////////////////////////////////////
+void FlightRecorder::Record(const gymfc::msgs::Action &_action,
+    const gymfc::msgs::State &_state, const double _simTime,
+    const double _force[3])
+{
+  if (!this->running || this->failed)
+  {
+    return;
+  }
+
+  if (this->current.Header()->count >= this->segmentRecords)
+  {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    // Only stalls if the flusher has fallen behind
+    while (!this->spare.data && !this->failed && this->running)
+    {
+      this->spareCondition.wait(lock);
+    }
+    if (!this->spare.data)
+    {
+      return;
+    }
+    this->retired.push_back(this->current);
+    this->current = this->spare;
+    this->spare = Segment();
+    lock.unlock();
+    this->flushCondition.notify_all();
+  }
+
+  FlightLogHeader *header = this->current.Header();
+  uint8_t *record = this->current.data + sizeof(FlightLogHeader) +
+    header->count * this->layout.recordSize;
+  this->layout.Encode(this->count, _action, _state, _simTime, _force, record);
+
+  // Publish the record to readers of the file only once it is complete
+  __atomic_store_n(&header->count, header->count + 1, __ATOMIC_RELEASE);
+
+  if (_action.world_control() == gymfc::msgs::Action::LOAD_DIGITAL_TWIN)
+  {
+    // Rare enough to write directly from the step thread
+    if (!this->twins.is_open())
+    {
+      this->twins.open(this->prefix + ".twins", std::ios::out | std::ios::app);
+    }
+    this->twins << this->count << " " << _action.digital_twin_sdf()
+      << std::endl;
+    if (!this->twins)
+    {
+      gzerr << "Could not write the digital twin path of step "
+        << this->count << " to " << this->prefix << ".twins\n";
+    }
+  }
+  this->count++;
+}
+
+/////////////////////////////////////////////////
+void FlightRecorder::FlushThread()
+{
+  std::unique_lock<std::mutex> lock(this->mutex);
+  while (this->running)
+  {
+    if (this->retired.empty() && (this->spare.data || this->failed))
+    {
+      this->flushCondition.wait_for(lock, std::chrono::milliseconds(100));
+    }
+
+    std::vector<Segment> full;
+    full.swap(this->retired);
+    // The step thread cannot advance while there is no spare, so the
+    // index of the current segment is stable until we provide one
+    bool needSpare = this->running && !this->spare.data && !this->failed;
+    uint32_t nextIndex = this->current.index + 1;
+    lock.unlock();
+
+    for (auto &segment : full)
+    {
+      this->ReleaseSegment(segment, false);
+    }
+    Segment next;
+    bool created = needSpare && this->CreateSegment(nextIndex, next);
+
+    lock.lock();
+    if (needSpare)
+    {
+      if (created)
+      {
+        this->spare = next;
+      }
+      else
+      {
+        gzerr << "Flight recorder could not create a new segment, "
+          << "recording stopped after " << this->count << " records\n";
+        this->failed = true;
+      }
+      this->spareCondition.notify_all();
+    }
+    // Start write back of the active segment, MS_ASYNC returns
+    // immediately so this does not hold up the step thread
+    if (this->current.data)
+    {
+      msync(this->current.data, this->current.size, MS_ASYNC);
+    }
+  }
+}
+
+/////////////////////////////////////////////////
+FlightLogReader::FlightLogReader()
+  : segmentIndex(0), recordIndex(0)
+{
+}
+
+/////////////////////////////////////////////////
+FlightLogReader::~FlightLogReader()
+{
+  this->Unmap();
+}
+
+/////////////////////////////////////////////////
+bool FlightLogReader::Open(const std::string &_prefix)
+{
+  this->prefix = _prefix;
+  this->segmentIndex = 0;
+  this->recordIndex = 0;
+  if (!this->Map(0))
+  {
+    return false;
+  }
+  this->layout = FlightLogLayout(this->Header()->numActuators);
+  if (this->layout.recordSize != this->Header()->recordSize)
+  {
+    gzerr << "Flight log " << _prefix << " record size "
+      << this->Header()->recordSize << " does not match this version\n";
+    this->Unmap();
+    return false;
+  }
+
+  this->twins.clear();
+  std::ifstream twinsFile(_prefix + ".twins");
+  uint64_t step;
+  std::string path;
+  while (twinsFile >> step && std::getline(twinsFile >> std::ws, path))
+  {
+    this->twins[step] = path;
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////
+const FlightLogLayout &FlightLogReader::Layout() const
+{
+  return this->layout;
+}
+
+/////////////////////////////////////////////////
+bool FlightLogReader::DigitalTwinSdf(const uint8_t *_record,
+    std::string &_path) const
+{
+  uint64_t step;
+  memcpy(&step, _record + this->layout.stepOffset, sizeof(step));
+  auto it = this->twins.find(step);
+  if (it == this->twins.end())
+  {
+    return false;
+  }
+  _path = it->second;
+  return true;
+}
+
+/////////////////////////////////////////////////
+const uint8_t *FlightLogReader::Next()
+{
+  while (this->data)
+  {
+    uint64_t count = __atomic_load_n(&this->Header()->count, __ATOMIC_ACQUIRE);
+    if (this->recordIndex < count)
+    {
+      return this->data + sizeof(FlightLogHeader) +
+        this->recordIndex++ * this->layout.recordSize;
+    }
+    // A segment which is not full is the last one of the log
+    if (count < this->Header()->capacity)
+    {
+      return nullptr;
+    }
+    this->Unmap();
+    this->Map(this->segmentIndex + 1);
+  }
+  return nullptr;
+}
+
+/////////////////////////////////////////////////
+bool FlightLogReader::Map(const uint32_t _index)
+{
+  std::string path = this->prefix + "." + std::to_string(_index);
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(FlightLogHeader))
+  {
+    close(fd);
+    return false;
+  }
+  void *mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED)
+  {
+    return false;
+  }
+  this->data = static_cast<const uint8_t *>(mapped);
+  this->size = st.st_size;
+  if (memcmp(this->Header()->magic, kFlightLogMagic,
+        sizeof(kFlightLogMagic)) != 0 ||
+      this->Header()->version != kFlightLogVersion)
+  {
+    gzerr << path << " is not a flight log\n";
+    this->Unmap();
+    return false;
+  }
+  this->segmentIndex = _index;
+  this->recordIndex = 0;
+  return true;
+}
+
+/////////////////////////////////////////////////
+void FlightLogReader::Unmap()
+{
+  if (this->data)
+  {
+    munmap(const_cast<uint8_t *>(this->data), this->size);
+  }
+  this->data = nullptr;
+  this->size = 0;
+}
+
+/////////////////////////////////////////////////
+const FlightLogHeader *FlightLogReader::Header() const
+{
+  return reinterpret_cast<const FlightLogHeader *>(this->data);
+}
@@ -0,0 +1,265 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GAZEBO_PLUGINS_FLIGHTRECORDER_HH_
+#define GAZEBO_PLUGINS_FLIGHTRECORDER_HH_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "State.pb.h"
+#include "Action.pb.h"
+
+namespace gazebo
+{
+  static const char kFlightLogMagic[8] = {'G', 'Y', 'M', 'F', 'C', 'L', 'O', 'G'};
+  static const uint32_t kFlightLogVersion = 6;
+
+  /// \brief Bits of the action_flags value of a record
+  static const uint32_t kFlightLogRandomize = 1;
+  static const uint32_t kFlightLogSeed = 2;
+  static const uint32_t kFlightLogTargetRate = 4;
+
+  /// \brief Header at the start of every flight log segment file. A flight
+  // log is a sequence of segment files named <prefix>.<index>, each holding
+  // a fixed number of records. All values are stored in host byte order.
+  struct FlightLogHeader
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t numActuators;
+    uint32_t recordSize;
+    uint32_t segmentIndex;
+    /// \brief Number of records the segment can hold
+    uint64_t capacity;
+    /// \brief Number of records written so far
+    uint64_t count;
+    uint8_t reserved[24];
+  };
+
+  /// \brief Layout of a single record, where N is the number of actuators.
+  // The record size is padded to a multiple of 8 bytes.
+  //
+  //  uint64 step                          Index of the record in the log
+  //  double sim_time
+  //  uint32 world_control                 Action::WorldControl
+  //  uint32 status_code                   State::StatusCode
+  //  uint32 action_flags                  Bit 0 Action::randomize, bit 1
+  //                                       set if Action::seed is present,
+  //                                       bit 2 if Action::target_rate is
+  //  uint32 seed                          Action::seed
+  //  uint32 done                          State::done
+  //  uint32 termination                   State::termination
+  //  float  motor[N]
+  //  float  target_rate[3]                Action::target_rate
+  //  float  imu_angular_velocity_rpy[3]
+  //  float  imu_linear_acceleration_xyz[3]
+  //  float  imu_orientation_quat[4]
+  //  float  esc_motor_angular_velocity[N]
+  //  float  esc_temperature[N]
+  //  float  esc_current[N]
+  //  float  esc_voltage[N]
+  //  float  esc_force[N]
+  //  float  esc_torque[N]
+  //  float  vbat_voltage
+  //  float  vbat_current
+  //  float  vbat_state_of_charge
+  //  float  setpoint[3]                   zero when setpoints are off
+  //  float  reward
+  //  float  link_drift                    zero when not monitored
+  //  double ball_joint_force[3]
+  //
+  // The SDF path of a LOAD_DIGITAL_TWIN action does not fit a fixed size
+  // record, it is appended to the text file <prefix>.twins as a line
+  // holding the step index and the path separated by a space.
+  class FlightLogLayout
+  {
+    public: explicit FlightLogLayout(const uint32_t _numActuators = 0);
+
+    /// \brief Write a single record.
+    /// \param[out] _record Destination of recordSize bytes
+    public: void Encode(const uint64_t _step,
+                const gymfc::msgs::Action &_action,
+                const gymfc::msgs::State &_state, const double _simTime,
+                const double _force[3], uint8_t *_record) const;
+
+    /// \brief Read the action stored in a record
+    public: void DecodeAction(const uint8_t *_record,
+                gymfc::msgs::Action &_action) const;
+
+    public: uint32_t numActuators;
+    public: uint32_t recordSize;
+
+    /// \brief Byte offsets of each group of values within a record
+    public: uint32_t stepOffset;
+    public: uint32_t simTimeOffset;
+    public: uint32_t worldControlOffset;
+    public: uint32_t statusCodeOffset;
+    public: uint32_t flagsOffset;
+    public: uint32_t doneOffset;
+    public: uint32_t motorOffset;
+    public: uint32_t targetRateOffset;
+    public: uint32_t stateOffset;
+    public: uint32_t forceOffset;
+
+    /// \brief Number of bytes of the state values, starting at
+    // stateOffset and ending right before the ball joint force
+    public: uint32_t stateSize;
+  };
+
+  /// \brief Appends every step to a memory-mapped flight log. Segment
+  // files are created, preallocated and mapped ahead of time by a
+  // background thread which also syncs and unmaps full segments, so the
+  // step thread only ever copies the record into mapped memory.
+  class FlightRecorder
+  {
+    /// \brief Constructor.
+    public: FlightRecorder();
+
+    /// \brief Destructor.
+    public: ~FlightRecorder();
+
+    /// \brief Create the first segments and start the flusher.
+    /// \param[in] _prefix Path prefix of the segment files
+    /// \param[in] _numActuators Number of motor values in each record
+    /// \param[in] _segmentRecords Number of records per segment file, at
+    /// least one
+    /// \return True if the log was created
+    public: bool Open(const std::string &_prefix,
+                const uint32_t _numActuators, const uint64_t _segmentRecords);
+
+    /// \brief Sync all data to disk and stop the flusher.
+    public: void Close();
+
+    /// \brief True if Open succeeded and the recorder has not been closed
+    public: bool IsOpen() const;
+
+    /// \brief Append a single step to the log.
+    public: void Record(const gymfc::msgs::Action &_action,
+                const gymfc::msgs::State &_state, const double _simTime,
+                const double _force[3]);
+
+    /// \brief Number of records written since the log was opened
+    public: uint64_t Count() const;
+
+    /// \brief Number of motor values in each record
+    public: uint32_t NumActuators() const;
+
+    /// \brief A single mapped segment file
+    private: struct Segment
+    {
+      int fd = -1;
+      uint8_t *data = nullptr;
+      size_t size = 0;
+      uint32_t index = 0;
+      FlightLogHeader *Header() const
+      {
+        return reinterpret_cast<FlightLogHeader *>(this->data);
+      }
+    };
+
+    /// \brief Create, preallocate and map the segment with the given index
+    private: bool CreateSegment(const uint32_t _index, Segment &_segment);
+
+    /// \brief Sync and unmap the segment
+    private: void ReleaseSegment(Segment &_segment, const bool _remove);
+
+    /// \brief Background thread retiring full segments and preparing the
+    // next spare segment
+    private: void FlushThread();
+
+    private: std::string prefix;
+    private: FlightLogLayout layout;
+    private: uint64_t segmentRecords;
+    private: uint64_t count;
+
+    /// \brief Segment currently written by the step thread
+    private: Segment current;
+
+    /// \brief Segment prepared by the flusher to be used once the current
+    // segment is full
+    private: Segment spare;
+
+    /// \brief Full segments waiting to be synced by the flusher
+    private: std::vector<Segment> retired;
+
+    private: std::thread flushThread;
+    private: std::mutex mutex;
+    private: std::condition_variable flushCondition;
+
+    /// \brief Signaled by the flusher once a spare segment is available
+    private: std::condition_variable spareCondition;
+    private: std::atomic<bool> running;
+
+    /// \brief Set if the flusher could not create a segment
+    private: std::atomic<bool> failed;
+
+    /// \brief Digital twin paths of LOAD_DIGITAL_TWIN records, opened
+    // with the first one
+    private: std::ofstream twins;
+  };
+
+  /// \brief Sequentially reads the records of a flight log written by
+  // FlightRecorder, one segment mapped at a time.
+  class FlightLogReader
+  {
+    /// \brief Constructor.
+    public: FlightLogReader();
+
+    /// \brief Destructor.
+    public: ~FlightLogReader();
+
+    /// \brief Map the first segment of the log.
+    /// \param[in] _prefix Path prefix the log was recorded with
+    /// \return True if the log exists and has a supported layout
+    public: bool Open(const std::string &_prefix);
+
+    public: const FlightLogLayout &Layout() const;
+
+    /// \brief Digital twin SDF path of a LOAD_DIGITAL_TWIN record
+    /// \param[in] _record Record returned by Next
+    /// \param[out] _path Path the twin was loaded from
+    /// \return False if the log holds no path for the record
+    public: bool DigitalTwinSdf(const uint8_t *_record,
+                std::string &_path) const;
+
+    /// \brief Return the next record or null once the end of the log
+    // is reached. The pointer is valid until the next call.
+    public: const uint8_t *Next();
+
+    private: bool Map(const uint32_t _index);
+    private: void Unmap();
+    private: const FlightLogHeader *Header() const;
+
+    private: std::string prefix;
+    private: FlightLogLayout layout;
+    private: const uint8_t *data = nullptr;
+    private: size_t size = 0;
+    private: uint32_t segmentIndex;
+    private: uint64_t recordIndex;
+
+    /// \brief Digital twin paths keyed by step index
+    private: std::map<uint64_t, std::string> twins;
+  };
+}
+#endif
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <algorithm>
+#include <cstring>
+
+#include <gazebo/common/common.hh>
+
+#include "ObservationHistory.hh"
+
+using namespace gazebo;
+
+typedef gymfc::msgs::State State;
+
+/// \brief Accessors of the State fields that can be enabled
+static const struct
+{
+  const char *name;
+  const google::protobuf::RepeatedField<float> &(State::*repeated)() const;
+  float (State::*scalar)() const;
+} kFields[] = {
+  {"imu_angular_velocity_rpy", &State::imu_angular_velocity_rpy, nullptr},
+  {"imu_linear_acceleration_xyz", &State::imu_linear_acceleration_xyz, nullptr},
+  {"imu_orientation_quat", &State::imu_orientation_quat, nullptr},
+  {"esc_motor_angular_velocity", &State::esc_motor_angular_velocity, nullptr},
+  {"esc_temperature", &State::esc_temperature, nullptr},
+  {"esc_current", &State::esc_current, nullptr},
+  {"esc_voltage", &State::esc_voltage, nullptr},
+  {"esc_force", &State::esc_force, nullptr},
+  {"esc_torque", &State::esc_torque, nullptr},
+  {"vbat_voltage", nullptr, &State::vbat_voltage},
+  {"vbat_current", nullptr, &State::vbat_current},
+  {"vbat_state_of_charge", nullptr, &State::vbat_state_of_charge},
+  {"setpoint", &State::setpoint, nullptr}
+};
+
+/////////////////////////////////////////////////
+void ObservationHistory::Configure(const unsigned int _length,
+    const std::vector<std::string> &_fields, const bool _actions,
+    const unsigned int _numActuators)
+{
+  this->length = _length;
+  this->actions = _actions;
+  this->fields.clear();
+  this->frameSize = 0;
+  this->actionSize = _actions ? _numActuators : 0;
+  this->stateRing.clear();
+  this->actionRing.clear();
+  this->head = 0;
+
+  for (auto &name : _fields)
+  {
+    auto field = std::find_if(std::begin(kFields), std::end(kFields),
+        [&name](decltype(kFields[0]) &_f) { return name == _f.name; });
+    if (field == std::end(kFields))
+    {
+      gzwarn << "State has no field " << name << ", leaving it out of the history.\n";
+      continue;
+    }
+    this->fields.push_back({field->repeated, field->scalar});
+  }
+}
+
+/////////////////////////////////////////////////
+unsigned int ObservationHistory::Length() const
+{
+  return this->length;
+}
+
+/////////////////////////////////////////////////
+bool ObservationHistory::Actions() const
+{
+  return this->actions;
+}
+
+/////////////////////////////////////////////////
+void ObservationHistory::Reset(gymfc::msgs::State &_state)
+{
+  if (this->length == 0)
+  {
+    return;
+  }
+
+  // Field sizes are fixed once the digital twin is loaded
+  this->frameSize = 0;
+  for (auto &field : this->fields)
+  {
+    this->frameSize += field.repeated ? (_state.*field.repeated)().size() : 1;
+  }
+  this->stateRing.resize(this->length * this->frameSize);
+  for (unsigned int i = 0; i < this->length; i++)
+  {
+    this->Pack(_state, &this->stateRing[i * this->frameSize]);
+  }
+  this->actionRing.assign(this->length * this->actionSize, 0);
+  this->head = 0;
+
+  this->Unroll(this->stateRing, this->frameSize, _state.mutable_history());
+  if (this->actions)
+  {
+    this->Unroll(this->actionRing, this->actionSize,
+        _state.mutable_action_history());
+  }
+}
+
+/////////////////////////////////////////////////
+void ObservationHistory::Push(gymfc::msgs::State &_state,
+    const gymfc::msgs::Action &_action)
+{
+  if (this->length == 0 || this->stateRing.empty())
+  {
+    return;
+  }
+
+  this->Pack(_state, &this->stateRing[this->head * this->frameSize]);
+  if (this->actions)
+  {
+    float *dst = &this->actionRing[this->head * this->actionSize];
+    unsigned int n = std::min(this->actionSize,
+        static_cast<unsigned int>(_action.motor_size()));
+    std::copy(_action.motor().begin(), _action.motor().begin() + n, dst);
+    std::fill(dst + n, dst + this->actionSize, 0.0f);
+  }
+  this->head = (this->head + 1) % this->length;
+
+  this->Unroll(this->stateRing, this->frameSize, _state.mutable_history());
+  if (this->actions)
+  {
+    this->Unroll(this->actionRing, this->actionSize,
+        _state.mutable_action_history());
+  }
+}
+
+/////////////////////////////////////////////////
+void ObservationHistory::Pack(const gymfc::msgs::State &_state,
+    float *_frame) const
+{
+  float *end = _frame + this->frameSize;
+  for (auto &field : this->fields)
+  {
+    if (field.repeated)
+    {
+      const google::protobuf::RepeatedField<float> &values =
+        (_state.*field.repeated)();
+      int n = std::min(values.size(), static_cast<int>(end - _frame));
+      memcpy(_frame, values.data(), n * sizeof(float));
+      _frame += n;
+    }
+    else if (_frame < end)
+    {
+      *_frame++ = (_state.*field.scalar)();
+    }
+  }
+}
+
+/////////////////////////////////////////////////
+void ObservationHistory::Unroll(const std::vector<float> &_ring,
+    const unsigned int _frameSize,
+    google::protobuf::RepeatedField<float> *_dst) const
+{
+  _dst->Resize(_ring.size(), 0);
+  if (_ring.empty())
+  {
+    return;
+  }
+  // The head slot holds the oldest frame
+  unsigned int split = this->head * _frameSize;
+  float *dst = _dst->mutable_data();
+  memcpy(dst, _ring.data() + split, (_ring.size() - split) * sizeof(float));
+  memcpy(dst + _ring.size() - split, _ring.data(), split * sizeof(float));
+}
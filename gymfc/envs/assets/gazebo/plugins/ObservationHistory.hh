@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GAZEBO_PLUGINS_OBSERVATIONHISTORY_HH_
+#define GAZEBO_PLUGINS_OBSERVATIONHISTORY_HH_
+
+#include <string>
+#include <vector>
+
+#include "Action.pb.h"
+#include "State.pb.h"
+
+namespace gazebo
+{
+  /// \brief Ring buffer of the last frames of the enabled state fields,
+  // and optionally of the motor commands, returned with every step as
+  // one contiguous block so the client does not have to stack frames.
+  // A frame holds the enabled fields flattened in the order the client
+  // flattens its observation.
+  class ObservationHistory
+  {
+    /// \brief Set the number of frames and the fields making up a frame.
+    // A length of 0 disables the history.
+    /// \param[in] _actions Also keep the last motor commands
+    /// \param[in] _numActuators Number of motor commands per frame
+    public: void Configure(const unsigned int _length,
+                const std::vector<std::string> &_fields, const bool _actions,
+                const unsigned int _numActuators);
+
+    /// \brief Number of frames kept, 0 if disabled
+    public: unsigned int Length() const;
+
+    /// \brief True if the motor commands are kept as well
+    public: bool Actions() const;
+
+    /// \brief Fill every frame with the state after a reset and zero
+    // motor commands, then write the history to the state.
+    public: void Reset(gymfc::msgs::State &_state);
+
+    /// \brief Append the current state and the motor commands that led to
+    // it, then write the history oldest frame first to the state.
+    public: void Push(gymfc::msgs::State &_state,
+                const gymfc::msgs::Action &_action);
+
+    /// \brief Flatten the enabled fields of the state into a frame
+    private: void Pack(const gymfc::msgs::State &_state, float *_frame) const;
+
+    /// \brief Copy a ring oldest frame first into the destination
+    private: void Unroll(const std::vector<float> &_ring,
+                const unsigned int _frameSize,
+                google::protobuf::RepeatedField<float> *_dst) const;
+
+    private: unsigned int length = 0;
+    private: bool actions = false;
+
+    /// \brief Accessor of a State field, only one of them is set
+    private: struct Field
+    {
+      const google::protobuf::RepeatedField<float> &(gymfc::msgs::State::*repeated)() const;
+      float (gymfc::msgs::State::*scalar)() const;
+    };
+
+    /// \brief Enabled fields that exist in the State
+    private: std::vector<Field> fields;
+
+    private: unsigned int frameSize = 0;
+    private: unsigned int actionSize = 0;
+    private: std::vector<float> stateRing;
+    private: std::vector<float> actionRing;
+
+    /// \brief Slot the next frame is written to, also the oldest frame
+    private: unsigned int head = 0;
+  };
+}
+#endif
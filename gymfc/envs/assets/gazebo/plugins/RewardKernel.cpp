@@ -0,0 +1,169 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <cmath>
+
+#include "RewardKernel.hh"
+
+using namespace gazebo;
+
+/////////////////////////////////////////////////
+/// \brief Return the value of the element or the default if missing
+static double Param(sdf::ElementPtr _sdf, const std::string &_name,
+    const double _default)
+{
+  return _sdf->HasElement(_name) ? _sdf->Get<double>(_name) : _default;
+}
+
+/////////////////////////////////////////////////
+/// \brief True if any value of the field is not finite
+static bool NonFinite(const google::protobuf::RepeatedField<float> &_values)
+{
+  for (float value : _values)
+  {
+    if (!std::isfinite(value))
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+/////////////////////////////////////////////////
+void RewardKernel::LoadReward(sdf::ElementPtr _sdf)
+{
+  this->enabled = true;
+  this->rateErrorWeight = Param(_sdf, "rateError", 0);
+  this->actionSmoothnessWeight = Param(_sdf, "actionSmoothness", 0);
+  this->motorSaturationWeight = Param(_sdf, "motorSaturation", 0);
+  this->ballJointForceWeight = Param(_sdf, "ballJointForce", 0);
+  this->motorMin = Param(_sdf, "motorMin", 0);
+  this->motorMax = Param(_sdf, "motorMax", 1);
+}
+
+/////////////////////////////////////////////////
+void RewardKernel::LoadTermination(sdf::ElementPtr _sdf)
+{
+  this->enabled = true;
+  this->terminateOnNan = _sdf->HasElement("nan") ? _sdf->Get<bool>("nan") : true;
+  this->maxRate = Param(_sdf, "maxRate", 0);
+  this->maxSimTime = Param(_sdf, "maxSimTime", 0);
+}
+
+/////////////////////////////////////////////////
+bool RewardKernel::Enabled() const
+{
+  return this->enabled;
+}
+
+/////////////////////////////////////////////////
+bool RewardKernel::UsesBallJointForce() const
+{
+  return this->ballJointForceWeight != 0;
+}
+
+/////////////////////////////////////////////////
+void RewardKernel::Reset(gymfc::msgs::State &_state)
+{
+  this->previousMotor.clear();
+  _state.set_reward(0);
+  _state.set_done(false);
+  _state.set_termination(0);
+}
+
+/////////////////////////////////////////////////
+void RewardKernel::Evaluate(const gymfc::msgs::Action &_action,
+    const ignition::math::Vector3d &_force, gymfc::msgs::State &_state)
+{
+  const google::protobuf::RepeatedField<float> &rates =
+    _state.imu_angular_velocity_rpy();
+  const google::protobuf::RepeatedField<float> &motor = _action.motor();
+
+  // Setpoints generated by the plugin take precedence over the target
+  const google::protobuf::RepeatedField<float> &target =
+    _state.setpoint_size() > 0 ? _state.setpoint() : _action.target_rate();
+
+  double reward = 0;
+  if (this->rateErrorWeight != 0 && target.size() == rates.size())
+  {
+    double error = 0;
+    for (int i = 0; i < rates.size(); i++)
+    {
+      error += std::abs(target.Get(i) - rates.Get(i));
+    }
+    reward += this->rateErrorWeight * error;
+  }
+
+  if (this->actionSmoothnessWeight != 0 &&
+      this->previousMotor.size() == static_cast<size_t>(motor.size()))
+  {
+    double change = 0;
+    for (int i = 0; i < motor.size(); i++)
+    {
+      change += std::abs(motor.Get(i) - this->previousMotor[i]);
+    }
+    reward += this->actionSmoothnessWeight * change;
+  }
+  this->previousMotor.assign(motor.begin(), motor.end());
+
+  if (this->motorSaturationWeight != 0 && motor.size() > 0)
+  {
+    int saturated = 0;
+    for (float value : motor)
+    {
+      saturated += value <= this->motorMin || value >= this->motorMax;
+    }
+    reward += this->motorSaturationWeight * saturated / motor.size();
+  }
+
+  if (this->ballJointForceWeight != 0)
+  {
+    reward += this->ballJointForceWeight * _force.Length();
+  }
+
+  uint32_t termination = 0;
+  if (this->terminateOnNan &&
+      (NonFinite(rates) || NonFinite(_state.imu_linear_acceleration_xyz()) ||
+       NonFinite(_state.imu_orientation_quat()) ||
+       NonFinite(_state.esc_motor_angular_velocity())))
+  {
+    termination |= kTerminationNan;
+  }
+  if (this->maxRate > 0)
+  {
+    for (float rate : rates)
+    {
+      if (std::abs(rate) > this->maxRate)
+      {
+        termination |= kTerminationRate;
+      }
+    }
+  }
+  if (this->maxSimTime > 0 && _state.sim_time() >= this->maxSimTime)
+  {
+    termination |= kTerminationSimTime;
+  }
+
+  // Keep a non-finite state from poisoning the return of the episode
+  if (!std::isfinite(reward))
+  {
+    reward = 0;
+  }
+
+  _state.set_reward(reward);
+  _state.set_done(termination != 0);
+  _state.set_termination(termination);
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GAZEBO_PLUGINS_REWARDKERNEL_HH_
+#define GAZEBO_PLUGINS_REWARDKERNEL_HH_
+
+#include <vector>
+
+#include <ignition/math/Vector3.hh>
+#include <sdf/sdf.hh>
+
+#include "Action.pb.h"
+#include "State.pb.h"
+
+namespace gazebo
+{
+  /// \brief Bits of State.termination
+  static const uint32_t kTerminationNan = 1;
+  static const uint32_t kTerminationRate = 2;
+  static const uint32_t kTerminationSimTime = 4;
+  static const uint32_t kTerminationUnstable = 8;
+
+  /// \brief Reward and termination computed in the plugin from the data
+  // of each step. The reward is the weighted sum of the selected terms,
+  // weights are usually negative as every term is a cost,
+  //
+  //  <reward>
+  //    <rateError>-1</rateError>          Sum of |target_rate - imu rate|,
+  //                                       against the generated setpoint
+  //                                       if there is one
+  //    <actionSmoothness>-0.1</actionSmoothness>
+  //                                       Sum of |motor - previous motor|
+  //    <motorSaturation>-0.5</motorSaturation>
+  //                                       Fraction of motors at motorMin
+  //                                       or motorMax
+  //    <motorMin>0</motorMin>
+  //    <motorMax>1</motorMax>
+  //    <ballJointForce>-0.01</ballJointForce>
+  //                                       Magnitude of the ball joint force
+  //  </reward>
+  //
+  //  <termination>
+  //    <nan>true</nan>                    Any state value is not finite
+  //    <maxRate>20</maxRate>              Any IMU rate above, rad/s
+  //    <maxSimTime>60</maxSimTime>        Episode sim time above, seconds
+  //  </termination>
+  class RewardKernel
+  {
+    /// \brief Load the reward terms
+    public: void LoadReward(sdf::ElementPtr _sdf);
+
+    /// \brief Load the termination checks
+    public: void LoadTermination(sdf::ElementPtr _sdf);
+
+    /// \brief True if any reward term or termination check is configured
+    public: bool Enabled() const;
+
+    /// \brief True if a reward term needs the ball joint force
+    public: bool UsesBallJointForce() const;
+
+    /// \brief Start a new episode
+    public: void Reset(gymfc::msgs::State &_state);
+
+    /// \brief Compute the reward and termination of a step and write them
+    // to the state
+    /// \param[in] _force Force on the ball joint during the step
+    public: void Evaluate(const gymfc::msgs::Action &_action,
+                const ignition::math::Vector3d &_force,
+                gymfc::msgs::State &_state);
+
+    private: bool enabled = false;
+
+    private: double rateErrorWeight = 0;
+    private: double actionSmoothnessWeight = 0;
+    private: double motorSaturationWeight = 0;
+    private: double ballJointForceWeight = 0;
+    private: double motorMin = 0;
+    private: double motorMax = 1;
+
+    private: bool terminateOnNan = true;
+    private: double maxRate = 0;
+    private: double maxSimTime = 0;
+
+    /// \brief Motor commands of the previous step
+    private: std::vector<float> previousMotor;
+  };
+}
+#endif
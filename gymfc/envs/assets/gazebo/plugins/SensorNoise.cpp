@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <gazebo/common/common.hh>
+
+#include "SensorNoise.hh"
+
+using namespace gazebo;
+
+typedef gymfc::msgs::State State;
+
+/// \brief Fields noise can be applied to
+static const struct
+{
+  const char *name;
+  google::protobuf::RepeatedField<float> *(State::*values)();
+} kFields[] = {
+  {"imu_angular_velocity_rpy", &State::mutable_imu_angular_velocity_rpy},
+  {"imu_linear_acceleration_xyz", &State::mutable_imu_linear_acceleration_xyz},
+  {"imu_orientation_quat", &State::mutable_imu_orientation_quat},
+  {"esc_motor_angular_velocity", &State::mutable_esc_motor_angular_velocity},
+  {"esc_temperature", &State::mutable_esc_temperature},
+  {"esc_current", &State::mutable_esc_current},
+  {"esc_voltage", &State::mutable_esc_voltage},
+  {"esc_force", &State::mutable_esc_force},
+  {"esc_torque", &State::mutable_esc_torque}
+};
+
+/// \brief Draws per value, one pair for the bias and one for white noise
+static const uint64_t kBiasDraw = 0;
+static const uint64_t kWhiteDraw = 1;
+
+/////////////////////////////////////////////////
+/// \brief SplitMix64 finalizer, a bijective hash of the counter
+static inline uint64_t Mix(uint64_t _x)
+{
+  _x += 0x9e3779b97f4a7c15ULL;
+  _x = (_x ^ (_x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  _x = (_x ^ (_x >> 27)) * 0x94d049bb133111ebULL;
+  return _x ^ (_x >> 31);
+}
+
+/////////////////////////////////////////////////
+/// \brief Uniform in (0, 1] from the top 53 bits of the hash
+static inline double Uniform(const uint64_t _key)
+{
+  return ((Mix(_key) >> 11) + 1) * (1.0 / 9007199254740992.0);
+}
+
+/////////////////////////////////////////////////
+bool SensorNoise::Load(sdf::ElementPtr _sdf)
+{
+  this->fields.clear();
+  if (_sdf->HasElement("seed"))
+  {
+    this->Seed(_sdf->Get<unsigned int>("seed"));
+  }
+
+  sdf::ElementPtr fieldSDF = _sdf->HasElement("field") ?
+    _sdf->GetElement("field") : sdf::ElementPtr();
+  while (fieldSDF)
+  {
+    std::string name = fieldSDF->GetAttribute("name")->GetAsString();
+    auto known = std::find_if(std::begin(kFields), std::end(kFields),
+        [&name](decltype(kFields[0]) &_f) { return name == _f.name; });
+    if (known == std::end(kFields))
+    {
+      gzerr << "Sensor noise can not be applied to " << name << "\n";
+      this->fields.clear();
+      return false;
+    }
+
+    SensorNoiseField field;
+    field.values = known->values;
+    field.name = name;
+    if (fieldSDF->HasElement("stddev"))
+    {
+      field.stddev = fieldSDF->Get<double>("stddev");
+    }
+    if (fieldSDF->HasElement("biasStddev"))
+    {
+      field.biasStddev = fieldSDF->Get<double>("biasStddev");
+    }
+    if (fieldSDF->HasElement("resolution"))
+    {
+      field.resolution = fieldSDF->Get<double>("resolution");
+    }
+    if (fieldSDF->HasElement("latency"))
+    {
+      field.latency = fieldSDF->Get<unsigned int>("latency");
+    }
+    this->fields.push_back(field);
+    fieldSDF = fieldSDF->GetNextElement("field");
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool SensorNoise::Enabled() const
+{
+  return !this->fields.empty();
+}
+
+/////////////////////////////////////////////////
+void SensorNoise::Seed(const uint32_t _seed)
+{
+  // Same as SetpointGenerator, the episode keeps counting so seeding every
+  // reset does not replay the noise of the first episode
+  this->seed = _seed;
+}
+
+/////////////////////////////////////////////////
+void SensorNoise::Reset(gymfc::msgs::State &_state)
+{
+  this->episode++;
+  this->step = 0;
+  for (auto &field : this->fields)
+  {
+    // Field sizes are fixed once the digital twin is loaded
+    const google::protobuf::RepeatedField<float> &values =
+      *(_state.*field.values)();
+    field.bias.assign(values.size(), 0);
+    field.delay.resize(field.latency * values.size());
+    for (unsigned int i = 0; i < field.latency; i++)
+    {
+      std::copy(values.begin(), values.end(),
+          field.delay.begin() + i * values.size());
+    }
+    field.head = 0;
+  }
+  this->Apply(_state, 0);
+}
+
+/////////////////////////////////////////////////
+void SensorNoise::Apply(gymfc::msgs::State &_state, const double _dt)
+{
+  uint64_t stepKey = Mix(Mix(Mix(this->seed) + this->episode) + this->step);
+  this->step++;
+
+  for (size_t f = 0; f < this->fields.size(); f++)
+  {
+    SensorNoiseField &field = this->fields[f];
+    google::protobuf::RepeatedField<float> *values = (_state.*field.values)();
+    size_t n = values->size();
+    if (n == 0 || n != field.bias.size())
+    {
+      continue;
+    }
+    float *data = values->mutable_data();
+
+    if (field.latency > 0)
+    {
+      // Swap the newest true values in for the oldest ones
+      float *slot = &field.delay[field.head * n];
+      for (size_t i = 0; i < n; i++)
+      {
+        std::swap(data[i], slot[i]);
+      }
+      field.head = (field.head + 1) % field.latency;
+    }
+
+    uint64_t fieldKey = Mix(stepKey + f);
+    if (field.biasStddev > 0 && _dt > 0)
+    {
+      this->Normals(Mix(fieldKey + kBiasDraw), n);
+      double scale = field.biasStddev * std::sqrt(_dt);
+      for (size_t i = 0; i < n; i++)
+      {
+        field.bias[i] += scale * this->normals[i];
+      }
+    }
+    if (field.stddev > 0)
+    {
+      this->Normals(Mix(fieldKey + kWhiteDraw), n);
+    }
+    else
+    {
+      this->normals.assign(n, 0);
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+      data[i] += field.bias[i] + field.stddev * this->normals[i];
+    }
+
+    if (field.resolution > 0)
+    {
+      double inverse = 1.0 / field.resolution;
+      for (size_t i = 0; i < n; i++)
+      {
+        data[i] = std::round(data[i] * inverse) * field.resolution;
+      }
+    }
+  }
+}
+
+/////////////////////////////////////////////////
+void SensorNoise::Normals(const uint64_t _key, const size_t _n)
+{
+  // Box-Muller, each value uses its own pair of counters
+  this->normals.resize(_n);
+  for (size_t i = 0; i < _n; i++)
+  {
+    double u1 = Uniform(_key + 2 * i);
+    double u2 = Uniform(_key + 2 * i + 1);
+    this->normals[i] = std::sqrt(-2 * std::log(u1)) * std::cos(2 * M_PI * u2);
+  }
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GAZEBO_PLUGINS_SENSORNOISE_HH_
+#define GAZEBO_PLUGINS_SENSORNOISE_HH_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <sdf/sdf.hh>
+
+#include "State.pb.h"
+
+namespace gazebo
+{
+  /// \brief Noise of a single IMU or ESC field of the state. The true
+  // values are delayed by the latency, offset by a bias following a random
+  // walk, perturbed by white noise and finally quantized.
+  //
+  //  <field name="imu_angular_velocity_rpy">
+  //    <stddev>0.01</stddev>              White noise
+  //    <biasStddev>0.001</biasStddev>     Bias random walk, per sqrt(s)
+  //    <resolution>0.001</resolution>     Quantization step
+  //    <latency>2</latency>               Delay in steps
+  //  </field>
+  struct SensorNoiseField
+  {
+    google::protobuf::RepeatedField<float> *(gymfc::msgs::State::*values)();
+    std::string name;
+    double stddev = 0;
+    double biasStddev = 0;
+    double resolution = 0;
+    unsigned int latency = 0;
+
+    /// \brief Current bias of each value
+    std::vector<double> bias;
+
+    /// \brief Last latency true values of each value, the oldest at head
+    std::vector<float> delay;
+    unsigned int head = 0;
+  };
+
+  /// \brief Applies noise to the sensor values of every step as they are
+  // packed into the state. Draws come from a counter based generator, a
+  // hash of the seed, episode index (resets since the plugin was loaded),
+  // step, field and value index, so the noise of a step does not depend on
+  // any earlier draw and is reproducible on any worker. Configured in the
+  // plugin SDF,
+  //
+  //  <sensorNoise>
+  //    <seed>0</seed>                     Optional, Action.seed on reset
+  //                                       takes precedence
+  //    <field name="...">...</field>
+  //  </sensorNoise>
+  class SensorNoise
+  {
+    /// \brief Load the noise of each field
+    /// \return False if a field is unknown
+    public: bool Load(sdf::ElementPtr _sdf);
+
+    /// \brief True once a field was loaded
+    public: bool Enabled() const;
+
+    /// \brief Replace the seed, the episode index keeps counting
+    public: void Seed(const uint32_t _seed);
+
+    /// \brief Start a new episode from the true values of the state and
+    // apply the noise to them
+    public: void Reset(gymfc::msgs::State &_state);
+
+    /// \brief Apply the noise to the true values of the state
+    /// \param[in] _dt Step size in seconds
+    public: void Apply(gymfc::msgs::State &_state, const double _dt);
+
+    /// \brief Fill the scratch buffer with standard normal draws
+    private: void Normals(const uint64_t _key, const size_t _n);
+
+    private: std::vector<SensorNoiseField> fields;
+
+    private: uint32_t seed = 0;
+    private: uint64_t episode = 0;
+    private: uint64_t step = 0;
+
+    /// \brief Reused draws of a single field
+    private: std::vector<double> normals;
+  };
+}
+#endif
@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GAZEBO_PLUGINS_SENSORREGISTRY_HH_
+#define GAZEBO_PLUGINS_SENSORREGISTRY_HH_
+
+#include <string>
+
+#include "Battery.pb.h"
+#include "EscSensor.pb.h"
+#include "Imu.pb.h"
+#include "State.pb.h"
+
+namespace gazebo
+{
+  /// \brief Sensors of the digital twin are described by a descriptor
+  // class with only static members,
+  //
+  //  MsgType           Message the digital twin publishes
+  //  Name()            Type attribute of the <sensor> in the twin SDF
+  //  TopicParam()      Plugin SDF element overriding the topic
+  //  DefaultTopic()    Topic, or topic prefix for multiple instances
+  //  FirstBit()        Bit of instance 0 in State.stale_sensors
+  //  Count(n)          Number of instances for a twin with n motors
+  //  Topic(t, i)       Topic of instance i given the configured topic t
+  //  Index(msg)        Instance a message was published by
+  //  Capacity(state)   Instances the state currently has room for
+  //  Init(state, n)    Append the slice of the state the sensor fills
+  //  Store(state, i, msg) Copy the message into the slice of instance i
+  //  Copy(dst, src)    Copy the slice of every instance between states
+  //
+  // Each sensor owns a dense slice of the State fields, one value per
+  // instance in each field. Adding a sensor only requires a descriptor
+  // and an entry in SensorRegistry, subscription and dispatch are
+  // generated from it at compile time.
+
+  /// \brief Inertial measurement unit, a single instance
+  class ImuSensor
+  {
+    public: typedef sensor_msgs::msgs::Imu MsgType;
+
+    public: static const char *Name()
+    {
+      return "imu";
+    }
+
+    public: static const char *TopicParam()
+    {
+      return "imuSubTopic";
+    }
+
+    public: static const char *DefaultTopic()
+    {
+      return "/aircraft/sensor/imu";
+    }
+
+    public: static int FirstBit()
+    {
+      return 0;
+    }
+
+    public: static int Count(const int /*_numActuators*/)
+    {
+      return 1;
+    }
+
+    public: static std::string Topic(const std::string &_topic,
+                const int /*_index*/)
+    {
+      return _topic;
+    }
+
+    public: static int Index(const MsgType &/*_msg*/)
+    {
+      return 0;
+    }
+
+    public: static int Capacity(const gymfc::msgs::State &_state)
+    {
+      return _state.imu_orientation_quat_size() == 4 ? 1 : 0;
+    }
+
+    public: static void Init(gymfc::msgs::State &_state,
+                const int /*_numActuators*/)
+    {
+      //XXX Initialize the state of the senors to a value
+      // that reflect the aircraft in an active state thus 
+      // forcing the sensors to be flushed.
+      for (unsigned int i = 0; i < 3; i++)
+      {
+        _state.add_imu_angular_velocity_rpy(1);
+        // TODO 
+        _state.add_imu_linear_acceleration_xyz(0);
+      }
+      for (unsigned int i = 0; i < 4; i++)
+      {
+        // TODO 
+        _state.add_imu_orientation_quat(0);
+      }
+    }
+
+    public: static void Store(gymfc::msgs::State &_state,
+                const int /*_index*/, const MsgType &_imu)
+    {
+      _state.set_imu_angular_velocity_rpy(0, _imu.angular_velocity().x());
+      _state.set_imu_angular_velocity_rpy(1, _imu.angular_velocity().y());
+      _state.set_imu_angular_velocity_rpy(2, _imu.angular_velocity().z());
+
+      _state.set_imu_orientation_quat(0, _imu.orientation().w());
+      _state.set_imu_orientation_quat(1, _imu.orientation().x());
+      _state.set_imu_orientation_quat(2, _imu.orientation().y());
+      _state.set_imu_orientation_quat(3, _imu.orientation().z());
+
+      _state.set_imu_linear_acceleration_xyz(0, _imu.linear_acceleration().x());
+      _state.set_imu_linear_acceleration_xyz(1, _imu.linear_acceleration().y());
+      _state.set_imu_linear_acceleration_xyz(2, _imu.linear_acceleration().z());
+    }
+
+    public: static void Copy(gymfc::msgs::State &_dst,
+                const gymfc::msgs::State &_src)
+    {
+      _dst.mutable_imu_angular_velocity_rpy()->CopyFrom(
+          _src.imu_angular_velocity_rpy());
+      _dst.mutable_imu_linear_acceleration_xyz()->CopyFrom(
+          _src.imu_linear_acceleration_xyz());
+      _dst.mutable_imu_orientation_quat()->CopyFrom(
+          _src.imu_orientation_quat());
+    }
+  };
+
+  /// \brief Electronic speed controller, one instance per motor, each
+  // publishing on <prefix>/<motor index>
+  class EscSensor
+  {
+    public: typedef sensor_msgs::msgs::EscSensor MsgType;
+
+    public: static const char *Name()
+    {
+      return "esc";
+    }
+
+    public: static const char *TopicParam()
+    {
+      return "escSubTopicPrefix";
+    }
+
+    public: static const char *DefaultTopic()
+    {
+      return "/aircraft/sensor/esc";
+    }
+
+    /// \brief Bit 1 is left for the battery
+    public: static int FirstBit()
+    {
+      return 2;
+    }
+
+    public: static int Count(const int _numActuators)
+    {
+      return _numActuators;
+    }
+
+    //Each defined motor will have a unique index, since they are indpendent they must come in 
+    //as separate messages
+    public: static std::string Topic(const std::string &_topic,
+                const int _index)
+    {
+      return _topic + "/" + std::to_string(_index);
+    }
+
+    public: static int Index(const MsgType &_msg)
+    {
+      return _msg.id();
+    }
+
+    public: static int Capacity(const gymfc::msgs::State &_state)
+    {
+      return _state.esc_motor_angular_velocity_size();
+    }
+
+    public: static void Init(gymfc::msgs::State &_state,
+                const int _numActuators)
+    {
+      for (int i = 0; i < _numActuators; i++)
+      {
+        _state.add_esc_motor_angular_velocity(100);
+        _state.add_esc_temperature(10000);
+        _state.add_esc_current(-1);
+        _state.add_esc_voltage(-1);
+        _state.add_esc_torque(0);
+        _state.add_esc_force(0);
+      }
+    }
+
+    public: static void Store(gymfc::msgs::State &_state, const int _index,
+                const MsgType &_esc)
+    {
+      _state.set_esc_motor_angular_velocity(_index, _esc.motor_speed());
+      _state.set_esc_temperature(_index, _esc.temperature());
+      _state.set_esc_current(_index, _esc.current());
+      _state.set_esc_voltage(_index, _esc.voltage());
+      _state.set_esc_force(_index, _esc.force());
+      _state.set_esc_torque(_index, _esc.torque());
+    }
+
+    public: static void Copy(gymfc::msgs::State &_dst,
+                const gymfc::msgs::State &_src)
+    {
+      _dst.mutable_esc_motor_angular_velocity()->CopyFrom(
+          _src.esc_motor_angular_velocity());
+      _dst.mutable_esc_temperature()->CopyFrom(_src.esc_temperature());
+      _dst.mutable_esc_current()->CopyFrom(_src.esc_current());
+      _dst.mutable_esc_voltage()->CopyFrom(_src.esc_voltage());
+      _dst.mutable_esc_force()->CopyFrom(_src.esc_force());
+      _dst.mutable_esc_torque()->CopyFrom(_src.esc_torque());
+    }
+  };
+
+  /// \brief Battery pack of the digital twin, a single instance
+  class BatterySensor
+  {
+    public: typedef sensor_msgs::msgs::Battery MsgType;
+
+    public: static const char *Name()
+    {
+      return "battery";
+    }
+
+    public: static const char *TopicParam()
+    {
+      return "batterySubTopic";
+    }
+
+    public: static const char *DefaultTopic()
+    {
+      return "/aircraft/sensor/battery";
+    }
+
+    public: static int FirstBit()
+    {
+      return 1;
+    }
+
+    public: static int Count(const int /*_numActuators*/)
+    {
+      return 1;
+    }
+
+    public: static std::string Topic(const std::string &_topic,
+                const int /*_index*/)
+    {
+      return _topic;
+    }
+
+    public: static int Index(const MsgType &/*_msg*/)
+    {
+      return 0;
+    }
+
+    public: static int Capacity(const gymfc::msgs::State &_state)
+    {
+      return _state.has_vbat_voltage() ? 1 : 0;
+    }
+
+    public: static void Init(gymfc::msgs::State &_state,
+                const int /*_numActuators*/)
+    {
+      _state.set_vbat_voltage(0);
+      _state.set_vbat_current(0);
+      _state.set_vbat_state_of_charge(0);
+    }
+
+    public: static void Store(gymfc::msgs::State &_state,
+                const int /*_index*/, const MsgType &_battery)
+    {
+      _state.set_vbat_voltage(_battery.voltage());
+      _state.set_vbat_current(_battery.current());
+      if (_battery.has_state_of_charge())
+      {
+        _state.set_vbat_state_of_charge(_battery.state_of_charge());
+      }
+    }
+
+    public: static void Copy(gymfc::msgs::State &_dst,
+                const gymfc::msgs::State &_src)
+    {
+      _dst.set_vbat_voltage(_src.vbat_voltage());
+      _dst.set_vbat_current(_src.vbat_current());
+      _dst.set_vbat_state_of_charge(_src.vbat_state_of_charge());
+    }
+  };
+
+  /// \brief Compile time list of sensor descriptors
+  template <typename... S>
+  class SensorList
+  {
+    public: static constexpr unsigned int kSize = sizeof...(S);
+
+    /// \brief Call _f(descriptor, index) for each sensor in order, the
+    // descriptor is an empty object only used to deduce its type
+    public: template <typename F>
+            static void ForEach(F &&_f)
+    {
+      unsigned int index = 0;
+      int expand[] = {0, (_f(S(), index++), 0)...};
+      (void)expand;
+    }
+  };
+
+  /// \brief All sensors the plugin can subscribe to
+  typedef SensorList<ImuSensor, EscSensor, BatterySensor> SensorRegistry;
+}
+#endif
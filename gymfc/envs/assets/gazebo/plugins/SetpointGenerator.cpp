@@ -0,0 +1,312 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <algorithm>
+#include <cmath>
+#include <initializer_list>
+
+#include <boost/algorithm/string.hpp>
+#include <gazebo/common/common.hh>
+
+#include "SetpointGenerator.hh"
+
+using namespace gazebo;
+
+/////////////////////////////////////////////////
+bool SetpointProfile::Load(sdf::ElementPtr _sdf)
+{
+  std::string typeName = _sdf->GetAttribute("type")->GetAsString();
+  if (!_sdf->HasElement("duration"))
+  {
+    gzerr << "Setpoint profile " << typeName << " requires a duration\n";
+    return false;
+  }
+  this->duration = _sdf->Get<double>("duration");
+  if (this->duration <= 0)
+  {
+    gzerr << "Setpoint profile " << typeName << " requires a positive duration\n";
+    return false;
+  }
+
+  // Every value of a profile is required
+  auto require = [&](const std::initializer_list<const char *> &_names)
+  {
+    for (const char *name : _names)
+    {
+      if (!_sdf->HasElement(name))
+      {
+        gzerr << "Setpoint profile " << typeName << " requires " << name << "\n";
+        return false;
+      }
+    }
+    return true;
+  };
+
+  if (boost::iequals(typeName, "step"))
+  {
+    if (!require({"value"}))
+    {
+      return false;
+    }
+    this->type = STEP;
+    this->from = _sdf->Get<ignition::math::Vector3d>("value");
+  }
+  else if (boost::iequals(typeName, "ramp"))
+  {
+    if (!require({"from", "to"}))
+    {
+      return false;
+    }
+    this->type = RAMP;
+    this->from = _sdf->Get<ignition::math::Vector3d>("from");
+    this->to = _sdf->Get<ignition::math::Vector3d>("to");
+  }
+  else if (boost::iequals(typeName, "pulses"))
+  {
+    if (!require({"amplitude", "minWidth", "maxWidth", "minGap", "maxGap"}))
+    {
+      return false;
+    }
+    this->type = PULSES;
+    this->to = _sdf->Get<ignition::math::Vector3d>("amplitude");
+    this->minWidth = _sdf->Get<double>("minWidth");
+    this->maxWidth = _sdf->Get<double>("maxWidth");
+    this->minGap = _sdf->Get<double>("minGap");
+    this->maxGap = _sdf->Get<double>("maxGap");
+    if (this->minWidth < 0 || this->maxWidth < this->minWidth ||
+        this->minGap < 0 || this->maxGap < this->minGap ||
+        this->maxWidth + this->maxGap <= 0)
+    {
+      gzerr << "Setpoint pulses require 0 <= minWidth <= maxWidth and "
+        << "0 <= minGap <= maxGap, with a non zero period\n";
+      return false;
+    }
+  }
+  else if (boost::iequals(typeName, "chirp"))
+  {
+    if (!require({"amplitude", "startFrequency", "endFrequency"}))
+    {
+      return false;
+    }
+    this->type = CHIRP;
+    this->to = _sdf->Get<ignition::math::Vector3d>("amplitude");
+    this->startFrequency = _sdf->Get<double>("startFrequency");
+    this->endFrequency = _sdf->Get<double>("endFrequency");
+    if (this->startFrequency < 0 || this->endFrequency < 0)
+    {
+      gzerr << "Setpoint chirp frequencies must not be negative\n";
+      return false;
+    }
+  }
+  else
+  {
+    gzerr << "Unknown setpoint profile type " << typeName << "\n";
+    return false;
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////
+void SetpointProfile::Begin()
+{
+  // Every profile of pulses starts with a gap of zero length
+  this->pulseActive = false;
+  this->pulseEnd = 0;
+  this->pulse = ignition::math::Vector3d();
+}
+
+/////////////////////////////////////////////////
+ignition::math::Vector3d SetpointProfile::Setpoint(const double _t,
+    std::mt19937 &_generator)
+{
+  switch (this->type)
+  {
+    case STEP:
+      return this->from;
+    case RAMP:
+    {
+      double s = this->duration > 0 ?
+        std::min(1.0, std::max(0.0, _t / this->duration)) : 1.0;
+      return this->from + (this->to - this->from) * s;
+    }
+    case PULSES:
+    {
+      std::uniform_real_distribution<double> unit(-1.0, 1.0);
+      while (_t >= this->pulseEnd)
+      {
+        this->pulseActive = !this->pulseActive;
+        if (this->pulseActive)
+        {
+          this->pulse.Set(this->to.X() * unit(_generator),
+              this->to.Y() * unit(_generator), this->to.Z() * unit(_generator));
+          this->pulseEnd += std::uniform_real_distribution<double>(
+              this->minWidth, this->maxWidth)(_generator);
+        }
+        else
+        {
+          this->pulse = ignition::math::Vector3d();
+          this->pulseEnd += std::uniform_real_distribution<double>(
+              this->minGap, this->maxGap)(_generator);
+        }
+      }
+      return this->pulse;
+    }
+    case CHIRP:
+    {
+      double rate = (this->endFrequency - this->startFrequency) /
+        this->duration;
+      double phase = 2 * M_PI * (this->startFrequency * _t +
+          0.5 * rate * _t * _t);
+      return this->to * std::sin(phase);
+    }
+  }
+  return ignition::math::Vector3d();
+}
+
+/////////////////////////////////////////////////
+double SetpointProfile::Duration() const
+{
+  return this->duration;
+}
+
+/////////////////////////////////////////////////
+bool SetpointGenerator::Load(sdf::ElementPtr _sdf)
+{
+  this->profiles.clear();
+  if (_sdf->HasElement("seed"))
+  {
+    this->Seed(_sdf->Get<unsigned int>("seed"));
+  }
+  this->repeat = _sdf->HasElement("repeat") && _sdf->Get<bool>("repeat");
+  this->curriculumEpisodes = 0;
+  this->initialScale = 1;
+  if (_sdf->HasElement("curriculum"))
+  {
+    sdf::ElementPtr curriculumSDF = _sdf->GetElement("curriculum");
+    if (!curriculumSDF->HasElement("episodes") ||
+        !curriculumSDF->HasElement("initialScale"))
+    {
+      gzerr << "Setpoint curriculum requires episodes and initialScale\n";
+      return false;
+    }
+    // Read signed so a negative count is reported instead of wrapping
+    int episodes = curriculumSDF->Get<int>("episodes");
+    this->initialScale = curriculumSDF->Get<double>("initialScale");
+    if (episodes <= 0 || this->initialScale < 0)
+    {
+      gzerr << "Setpoint curriculum requires a positive number of episodes "
+        << "and a non negative initialScale\n";
+      this->initialScale = 1;
+      return false;
+    }
+    this->curriculumEpisodes = episodes;
+  }
+
+  sdf::ElementPtr profileSDF = _sdf->HasElement("profile") ?
+    _sdf->GetElement("profile") : sdf::ElementPtr();
+  while (profileSDF)
+  {
+    SetpointProfile profile;
+    if (!profile.Load(profileSDF))
+    {
+      this->profiles.clear();
+      return false;
+    }
+    this->profiles.push_back(profile);
+    profileSDF = profileSDF->GetNextElement("profile");
+  }
+  if (this->profiles.empty())
+  {
+    gzerr << "Setpoints require at least one profile\n";
+    return false;
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool SetpointGenerator::Enabled() const
+{
+  return !this->profiles.empty();
+}
+
+/////////////////////////////////////////////////
+void SetpointGenerator::Seed(const uint32_t _seed)
+{
+  // The episode keeps counting so a client seeding every reset still
+  // moves through the curriculum and draws a new schedule each episode
+  this->seed = _seed;
+}
+
+/////////////////////////////////////////////////
+void SetpointGenerator::Reset(gymfc::msgs::State &_state)
+{
+  std::seed_seq sequence{this->seed,
+    static_cast<uint32_t>(this->episode),
+    static_cast<uint32_t>(this->episode >> 32)};
+  this->generator.seed(sequence);
+
+  this->scale = 1;
+  if (this->curriculumEpisodes > 0)
+  {
+    double progress = std::min(1.0,
+        static_cast<double>(this->episode) / this->curriculumEpisodes);
+    this->scale = this->initialScale + (1 - this->initialScale) * progress;
+  }
+  this->episode++;
+
+  this->current = 0;
+  this->profileStart = _state.sim_time();
+  this->profiles[0].Begin();
+  this->Update(_state);
+}
+
+/////////////////////////////////////////////////
+void SetpointGenerator::Update(gymfc::msgs::State &_state)
+{
+  double t = _state.sim_time();
+  while (this->current < this->profiles.size() &&
+      t - this->profileStart >= this->profiles[this->current].Duration())
+  {
+    this->profileStart += this->profiles[this->current].Duration();
+    this->current++;
+    if (this->current == this->profiles.size() && this->repeat)
+    {
+      this->current = 0;
+    }
+    if (this->current < this->profiles.size())
+    {
+      this->profiles[this->current].Begin();
+    }
+  }
+
+  if (this->current == this->profiles.size())
+  {
+    this->Write(_state, ignition::math::Vector3d());
+    return;
+  }
+  this->Write(_state, this->profiles[this->current].Setpoint(
+        t - this->profileStart, this->generator) * this->scale);
+}
+
+/////////////////////////////////////////////////
+void SetpointGenerator::Write(gymfc::msgs::State &_state,
+    const ignition::math::Vector3d &_setpoint) const
+{
+  _state.clear_setpoint();
+  _state.add_setpoint(_setpoint.X());
+  _state.add_setpoint(_setpoint.Y());
+  _state.add_setpoint(_setpoint.Z());
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GAZEBO_PLUGINS_SETPOINTGENERATOR_HH_
+#define GAZEBO_PLUGINS_SETPOINTGENERATOR_HH_
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <ignition/math/Vector3.hh>
+#include <sdf/sdf.hh>
+
+#include "State.pb.h"
+
+namespace gazebo
+{
+  /// \brief Angular rate setpoint profile in rad/s for roll, pitch and
+  // yaw, vectors are given as "roll pitch yaw",
+  //
+  //  <profile type="step">   <value>, held for the duration
+  //  <profile type="ramp">   <from>, <to>, linear over the duration
+  //  <profile type="pulses"> <amplitude>, <minWidth>, <maxWidth>,
+  //                          <minGap>, <maxGap>, pulses of a uniform
+  //                          random rate within +-amplitude and random
+  //                          width separated by random gaps at zero
+  //  <profile type="chirp">  <amplitude>, <startFrequency>,
+  //                          <endFrequency>, a linear frequency sweep
+  //
+  // All profiles require a <duration> in seconds of sim time.
+  class SetpointProfile
+  {
+    public: enum Type
+    {
+      STEP,
+      RAMP,
+      PULSES,
+      CHIRP
+    };
+
+    /// \brief Load the profile from its SDF element
+    /// \return False if the profile is missing required values
+    public: bool Load(sdf::ElementPtr _sdf);
+
+    /// \brief Start the profile
+    public: void Begin();
+
+    /// \brief Setpoint at the given time since the profile started
+    public: ignition::math::Vector3d Setpoint(const double _t,
+                std::mt19937 &_generator);
+
+    public: double Duration() const;
+
+    private: Type type = STEP;
+    private: double duration = 0;
+    private: ignition::math::Vector3d from;
+    private: ignition::math::Vector3d to;
+    private: double minWidth = 0;
+    private: double maxWidth = 0;
+    private: double minGap = 0;
+    private: double maxGap = 0;
+    private: double startFrequency = 0;
+    private: double endFrequency = 0;
+
+    /// \brief Current pulse and the time it ends
+    private: bool pulseActive = false;
+    private: double pulseEnd = 0;
+    private: ignition::math::Vector3d pulse;
+  };
+
+  /// \brief Generates the rate setpoint of every step from a sequence of
+  // profiles run one after the other each episode. Configured in the
+  // plugin SDF,
+  //
+  //  <setpoints>
+  //    <seed>0</seed>                     Optional, Action.seed on reset
+  //                                       takes precedence
+  //    <repeat>false</repeat>             Restart the sequence once done,
+  //                                       otherwise hold zero
+  //    <curriculum>                       Optional, scale the setpoints
+  //      <episodes>500</episodes>         linearly from initialScale to 1
+  //      <initialScale>0.2</initialScale> over the first episodes
+  //    </curriculum>
+  //    <profile type="pulses">...</profile>
+  //  </setpoints>
+  //
+  // The random draws of an episode only depend on the seed and the
+  // episode index, the number of resets since the plugin was loaded, so a
+  // schedule is reproducible on any worker.
+  class SetpointGenerator
+  {
+    /// \brief Load the profiles
+    /// \return False if a profile or the curriculum is invalid, no
+    /// setpoints are generated then
+    public: bool Load(sdf::ElementPtr _sdf);
+
+    /// \brief True once profiles were loaded
+    public: bool Enabled() const;
+
+    /// \brief Replace the seed, the episode index keeps counting
+    public: void Seed(const uint32_t _seed);
+
+    /// \brief Start a new episode and write the initial setpoint
+    public: void Reset(gymfc::msgs::State &_state);
+
+    /// \brief Write the setpoint at the sim time of the state
+    public: void Update(gymfc::msgs::State &_state);
+
+    private: void Write(gymfc::msgs::State &_state,
+                 const ignition::math::Vector3d &_setpoint) const;
+
+    private: std::vector<SetpointProfile> profiles;
+    private: bool repeat = false;
+    private: unsigned int curriculumEpisodes = 0;
+    private: double initialScale = 1;
+
+    private: uint32_t seed = 0;
+    private: uint64_t episode = 0;
+    private: double scale = 1;
+    private: std::mt19937 generator;
+
+    /// \brief Profile running and the sim time it started
+    private: size_t current = 0;
+    private: double profileStart = 0;
+  };
+}
+#endif
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <algorithm>
+#include <cmath>
+
+#include <gazebo/common/common.hh>
+
+#include "StabilityMonitor.hh"
+
+using namespace gazebo;
+
+/////////////////////////////////////////////////
+void StabilityMonitor::Load(sdf::ElementPtr _sdf)
+{
+  this->enabled = true;
+  if (_sdf->HasElement("interval"))
+  {
+    this->interval = std::max(1u, _sdf->Get<unsigned int>("interval"));
+  }
+  if (_sdf->HasElement("threshold"))
+  {
+    this->threshold = _sdf->Get<double>("threshold");
+  }
+}
+
+/////////////////////////////////////////////////
+bool StabilityMonitor::Enabled() const
+{
+  return this->enabled;
+}
+
+/////////////////////////////////////////////////
+void StabilityMonitor::Snapshot(physics::ModelPtr _model)
+{
+  this->links = _model->GetLinks();
+  size_t n = this->links.size();
+  this->x.resize(n);
+  this->y.resize(n);
+  this->z.resize(n);
+  this->Positions();
+  this->Distances(this->initial);
+  this->current.resize(this->initial.size());
+  this->Reset();
+}
+
+/////////////////////////////////////////////////
+void StabilityMonitor::Clear()
+{
+  this->links.clear();
+  this->initial.clear();
+  this->current.clear();
+  this->Reset();
+}
+
+/////////////////////////////////////////////////
+void StabilityMonitor::Reset()
+{
+  this->steps = 0;
+  this->drift = 0;
+  this->unstable = false;
+}
+
+/////////////////////////////////////////////////
+bool StabilityMonitor::Check()
+{
+  if (this->unstable || this->initial.empty() ||
+      ++this->steps < this->interval)
+  {
+    return this->unstable;
+  }
+  this->steps = 0;
+
+  this->Positions();
+  this->Distances(this->current);
+  double largest = 0;
+  for (size_t i = 0; i < this->current.size(); i++)
+  {
+    largest = std::max(largest, std::abs(this->current[i] - this->initial[i]));
+  }
+  this->drift = largest;
+
+  // A non-finite position means the twin already blew up
+  if (!(largest <= this->threshold))
+  {
+    this->unstable = true;
+    gzwarn << "Digital twin unstable, a link to link distance changed by "
+      << largest << " m.\n";
+  }
+  return this->unstable;
+}
+
+/////////////////////////////////////////////////
+double StabilityMonitor::Drift() const
+{
+  return this->drift;
+}
+
+/////////////////////////////////////////////////
+void StabilityMonitor::Positions()
+{
+  for (size_t i = 0; i < this->links.size(); i++)
+  {
+    ignition::math::Vector3d position = this->links[i]->WorldPose().Pos();
+    this->x[i] = position.X();
+    this->y[i] = position.Y();
+    this->z[i] = position.Z();
+  }
+}
+
+/////////////////////////////////////////////////
+void StabilityMonitor::Distances(std::vector<double> &_dst) const
+{
+  size_t n = this->x.size();
+  _dst.resize(n * (n - std::min<size_t>(n, 1)) / 2);
+  double *dst = _dst.data();
+  for (size_t i = 0; i < n; i++)
+  {
+    // Contiguous inner loop over the remaining links
+    const double xi = this->x[i];
+    const double yi = this->y[i];
+    const double zi = this->z[i];
+    for (size_t j = i + 1; j < n; j++)
+    {
+      double dx = this->x[j] - xi;
+      double dy = this->y[j] - yi;
+      double dz = this->z[j] - zi;
+      *dst++ = std::sqrt(dx * dx + dy * dy + dz * dz);
+    }
+  }
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GAZEBO_PLUGINS_STABILITYMONITOR_HH_
+#define GAZEBO_PLUGINS_STABILITYMONITOR_HH_
+
+#include <cstdint>
+#include <vector>
+
+#include <gazebo/physics/physics.hh>
+#include <sdf/sdf.hh>
+
+namespace gazebo
+{
+  /// \brief Detects a digital twin coming apart, for example exploding
+  // joints. The distances between every pair of links are recorded once
+  // the twin is inserted and compared to the current ones every few
+  // steps. Configured in the plugin SDF,
+  //
+  //  <stabilityMonitor>
+  //    <interval>10</interval>            Steps between checks
+  //    <threshold>0.001</threshold>       Largest change of any link to
+  //                                       link distance, meters
+  //  </stabilityMonitor>
+  class StabilityMonitor
+  {
+    /// \brief Load the check interval and threshold
+    public: void Load(sdf::ElementPtr _sdf);
+
+    /// \brief True once loaded
+    public: bool Enabled() const;
+
+    /// \brief Record the link to link distances of a newly inserted twin
+    public: void Snapshot(physics::ModelPtr _model);
+
+    /// \brief Forget the twin
+    public: void Clear();
+
+    /// \brief Start a new episode, the twin is assumed to be restored
+    public: void Reset();
+
+    /// \brief Account for a step and check the distances when due
+    /// \return True once the twin is unstable, until the next reset
+    public: bool Check();
+
+    /// \brief Largest distance change seen at the last check
+    public: double Drift() const;
+
+    /// \brief Gather the link positions into x, y and z
+    private: void Positions();
+
+    /// \brief Pairwise link distances into the destination, upper
+    // triangle row by row
+    private: void Distances(std::vector<double> &_dst) const;
+
+    private: bool enabled = false;
+    private: unsigned int interval = 10;
+    private: double threshold = 1e-3;
+
+    private: physics::Link_V links;
+    private: std::vector<double> x;
+    private: std::vector<double> y;
+    private: std::vector<double> z;
+    private: std::vector<double> initial;
+    private: std::vector<double> current;
+
+    private: unsigned int steps = 0;
+    private: double drift = 0;
+    private: bool unstable = false;
+  };
+}
+#endif
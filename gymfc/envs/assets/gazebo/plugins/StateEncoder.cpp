@@ -0,0 +1,258 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <algorithm>
+#include <cstring>
+
+#include "StateEncoder.hh"
+
+using namespace gazebo;
+
+typedef gymfc::msgs::State State;
+
+/// \brief Highest field number of the State
+static const int kMaxField = State::kLinkDriftFieldNumber;
+
+/// \brief Values are copied in host byte order, the wire is little endian
+static const bool kLittleEndian =
+  __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+
+/////////////////////////////////////////////////
+/// \brief Read a varint, advancing the position
+static uint64_t ReadVarint(const std::string &_buffer, size_t &_pos)
+{
+  uint64_t value = 0;
+  for (int shift = 0; _pos < _buffer.size() && shift < 64; shift += 7)
+  {
+    uint8_t byte = _buffer[_pos++];
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80))
+    {
+      break;
+    }
+  }
+  return value;
+}
+
+/////////////////////////////////////////////////
+/// \brief Number of bytes of the varint encoding of the value
+static uint32_t VarintSize(uint64_t _value)
+{
+  uint32_t size = 1;
+  while (_value >= 0x80)
+  {
+    _value >>= 7;
+    size++;
+  }
+  return size;
+}
+
+/////////////////////////////////////////////////
+const std::string &StateEncoder::Encode(const State &_state)
+{
+  if (!kLittleEndian || !this->valid || !this->Patch(_state))
+  {
+    this->valid = this->Build(_state);
+  }
+  return this->buffer;
+}
+
+/////////////////////////////////////////////////
+uint64_t StateEncoder::Builds() const
+{
+  return this->builds;
+}
+
+/////////////////////////////////////////////////
+bool StateEncoder::Build(const State &_state)
+{
+  this->builds++;
+  this->buffer.clear();
+  _state.SerializeToString(&this->buffer);
+  this->slots.assign(kMaxField + 1, Slot());
+
+  size_t pos = 0;
+  while (pos < this->buffer.size())
+  {
+    uint64_t tag = ReadVarint(this->buffer, pos);
+    uint64_t number = tag >> 3;
+    int wireType = static_cast<int>(tag & 7);
+
+    // The info is only sent once, it is not worth a template
+    if (number == 0 || number > static_cast<uint64_t>(kMaxField) ||
+        number == State::kInfoFieldNumber || this->slots[number].present)
+    {
+      return false;
+    }
+
+    Slot &slot = this->slots[number];
+    slot.present = true;
+    switch (wireType)
+    {
+      // Varint
+      case 0:
+      {
+        size_t start = pos;
+        ReadVarint(this->buffer, pos);
+        slot.offset = start;
+        slot.count = pos - start;
+        break;
+      }
+      // 64 bit
+      case 1:
+        slot.offset = pos;
+        pos += 8;
+        break;
+      // Length delimited, a packed float array
+      case 2:
+      {
+        uint64_t length = ReadVarint(this->buffer, pos);
+        slot.offset = pos;
+        slot.count = length / sizeof(float);
+        pos += length;
+        break;
+      }
+      // 32 bit
+      case 5:
+        slot.offset = pos;
+        pos += 4;
+        break;
+      default:
+        return false;
+    }
+  }
+  return pos == this->buffer.size();
+}
+
+/////////////////////////////////////////////////
+bool StateEncoder::PatchFloats(const int _number,
+    const google::protobuf::RepeatedField<float> &_values)
+{
+  const Slot &slot = this->slots[_number];
+  if (slot.count != static_cast<uint32_t>(_values.size()))
+  {
+    return false;
+  }
+  memcpy(&this->buffer[slot.offset], _values.data(),
+      slot.count * sizeof(float));
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool StateEncoder::PatchFloat(const int _number, const bool _has,
+    const float _value)
+{
+  const Slot &slot = this->slots[_number];
+  if (slot.present != _has)
+  {
+    return false;
+  }
+  if (_has)
+  {
+    memcpy(&this->buffer[slot.offset], &_value, sizeof(_value));
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool StateEncoder::PatchFixed64(const int _number, const bool _has,
+    const uint64_t _value)
+{
+  const Slot &slot = this->slots[_number];
+  if (slot.present != _has)
+  {
+    return false;
+  }
+  if (_has)
+  {
+    memcpy(&this->buffer[slot.offset], &_value, sizeof(_value));
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool StateEncoder::PatchVarint(const int _number, const bool _has,
+    uint64_t _value)
+{
+  const Slot &slot = this->slots[_number];
+  if (slot.present != _has)
+  {
+    return false;
+  }
+  if (!_has)
+  {
+    return true;
+  }
+  if (VarintSize(_value) != slot.count)
+  {
+    return false;
+  }
+  for (uint32_t b = 0; b < slot.count; b++)
+  {
+    uint8_t byte = _value & 0x7f;
+    _value >>= 7;
+    this->buffer[slot.offset + b] = b + 1 < slot.count ? byte | 0x80 : byte;
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////
+bool StateEncoder::Patch(const State &_state)
+{
+  // A mismatch leaves the template partly patched, it is rebuilt anyway
+  return !_state.has_info() &&
+    this->PatchFloat(State::kSimTimeFieldNumber, _state.has_sim_time(),
+        _state.sim_time()) &&
+    this->PatchFloats(State::kImuAngularVelocityRpyFieldNumber,
+        _state.imu_angular_velocity_rpy()) &&
+    this->PatchFloats(State::kImuLinearAccelerationXyzFieldNumber,
+        _state.imu_linear_acceleration_xyz()) &&
+    this->PatchFloats(State::kImuOrientationQuatFieldNumber,
+        _state.imu_orientation_quat()) &&
+    this->PatchFloats(State::kEscMotorAngularVelocityFieldNumber,
+        _state.esc_motor_angular_velocity()) &&
+    this->PatchFloats(State::kEscTemperatureFieldNumber,
+        _state.esc_temperature()) &&
+    this->PatchFloats(State::kEscCurrentFieldNumber, _state.esc_current()) &&
+    this->PatchFloats(State::kEscVoltageFieldNumber, _state.esc_voltage()) &&
+    this->PatchFloats(State::kEscForceFieldNumber, _state.esc_force()) &&
+    this->PatchFloats(State::kEscTorqueFieldNumber, _state.esc_torque()) &&
+    this->PatchFloat(State::kVbatVoltageFieldNumber,
+        _state.has_vbat_voltage(), _state.vbat_voltage()) &&
+    this->PatchFloat(State::kVbatCurrentFieldNumber,
+        _state.has_vbat_current(), _state.vbat_current()) &&
+    this->PatchVarint(State::kStatusCodeFieldNumber,
+        _state.has_status_code(), _state.status_code()) &&
+    this->PatchFloats(State::kForceFieldNumber, _state.force()) &&
+    this->PatchFixed64(State::kStaleSensorsFieldNumber,
+        _state.has_stale_sensors(), _state.stale_sensors()) &&
+    this->PatchFixed64(State::kSensorTimeoutsFieldNumber,
+        _state.has_sensor_timeouts(), _state.sensor_timeouts()) &&
+    this->PatchFloat(State::kVbatStateOfChargeFieldNumber,
+        _state.has_vbat_state_of_charge(), _state.vbat_state_of_charge()) &&
+    this->PatchFloats(State::kHistoryFieldNumber, _state.history()) &&
+    this->PatchFloats(State::kActionHistoryFieldNumber,
+        _state.action_history()) &&
+    this->PatchFloat(State::kRewardFieldNumber, _state.has_reward(),
+        _state.reward()) &&
+    this->PatchVarint(State::kDoneFieldNumber, _state.has_done(),
+        _state.done()) &&
+    this->PatchVarint(State::kTerminationFieldNumber,
+        _state.has_termination(), _state.termination()) &&
+    this->PatchFloats(State::kSetpointFieldNumber, _state.setpoint()) &&
+    this->PatchFloat(State::kLinkDriftFieldNumber, _state.has_link_drift(),
+        _state.link_drift());
+}
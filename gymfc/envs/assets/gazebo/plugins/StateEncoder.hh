@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GAZEBO_PLUGINS_STATEENCODER_HH_
+#define GAZEBO_PLUGINS_STATEENCODER_HH_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "State.pb.h"
+
+namespace gazebo
+{
+  /// \brief Encodes the State sent after every step. The field sizes of
+  // the state are fixed once the digital twin is loaded, so the encoding
+  // only differs in the value bytes. The state is serialized once into a
+  // template and the offset of every value is recorded, following encodes
+  // copy the float arrays and scalars over their old bytes in place. The
+  // template is rebuilt whenever a field appears, disappears, changes size
+  // or a varint needs a different number of bytes. States carrying the
+  // environment info are always fully serialized. Patch lists every
+  // field of the State and must be extended along with it.
+  class StateEncoder
+  {
+    /// \brief Encode the state
+    /// \return Encoded bytes, valid until the next call
+    public: const std::string &Encode(const gymfc::msgs::State &_state);
+
+    /// \brief Number of times the template was built
+    public: uint64_t Builds() const;
+
+    /// \brief Location of a field of the state in the template
+    private: struct Slot
+    {
+      bool present = false;
+      /// \brief Number of floats of a packed field, bytes of a varint
+      uint32_t count = 0;
+      uint32_t offset = 0;
+    };
+
+    /// \brief Serialize the state and locate every field in the template
+    /// \return False if the template contains fields that can not be
+    // patched
+    private: bool Build(const gymfc::msgs::State &_state);
+
+    /// \brief Copy the values of the state into the template
+    /// \return False if the state no longer matches the template
+    private: bool Patch(const gymfc::msgs::State &_state);
+
+    /// \brief Copy a packed float field over its payload
+    private: bool PatchFloats(const int _number,
+                 const google::protobuf::RepeatedField<float> &_values);
+
+    private: bool PatchFloat(const int _number, const bool _has,
+                 const float _value);
+
+    private: bool PatchFixed64(const int _number, const bool _has,
+                 const uint64_t _value);
+
+    /// \brief Encode a varint over the old one, which must have the same
+    // number of bytes
+    private: bool PatchVarint(const int _number, const bool _has,
+                 uint64_t _value);
+
+    private: std::string buffer;
+
+    /// \brief Slots indexed by field number
+    private: std::vector<Slot> slots;
+
+    /// \brief True if the buffer is a template that can be patched
+    private: bool valid = false;
+
+    private: uint64_t builds = 0;
+  };
+}
+#endif
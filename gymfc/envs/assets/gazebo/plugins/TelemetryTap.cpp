@@ -0,0 +1,259 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#include <gazebo/common/common.hh>
+
+#include "TelemetryTap.hh"
+
+using namespace gazebo;
+
+/////////////////////////////////////////////////
+TelemetryTap::~TelemetryTap()
+{
+  this->Close();
+}
+
+/////////////////////////////////////////////////
+bool TelemetryTap::Open(const std::string &_name,
+    const uint32_t _numActuators, const TelemetryMode _mode,
+    const uint32_t _decimation, const uint32_t _capacity)
+{
+  this->Close();
+  if (_decimation == 0 || _capacity == 0)
+  {
+    gzerr << "Telemetry requires a positive decimation and capacity\n";
+    return false;
+  }
+
+  this->name = _name;
+  this->layout = FlightLogLayout(_numActuators);
+  this->mode = _mode;
+  this->decimation = _decimation;
+  this->windowCount = 0;
+  this->record.assign(this->layout.recordSize, 0);
+  uint32_t payloadSize = this->layout.recordSize *
+    (_mode == TELEMETRY_STATS ? 3 : 1);
+  this->stats.assign(payloadSize, 0);
+
+  uint32_t slotSize = sizeof(TelemetrySlot) + payloadSize;
+  this->size = sizeof(TelemetryHeader) +
+    static_cast<size_t>(slotSize) * _capacity;
+
+  // Readers of a previous run keep their mapping of the old object
+  shm_unlink(_name.c_str());
+  int fd = shm_open(_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0)
+  {
+    gzerr << "Could not create telemetry shared memory " << _name << ", "
+      << strerror(errno) << "\n";
+    return false;
+  }
+  if (ftruncate(fd, this->size) != 0)
+  {
+    gzerr << "Could not size telemetry shared memory " << _name << ", "
+      << strerror(errno) << "\n";
+    close(fd);
+    shm_unlink(_name.c_str());
+    return false;
+  }
+  void *addr = mmap(nullptr, this->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+      fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED)
+  {
+    gzerr << "Could not map telemetry shared memory " << _name << ", "
+      << strerror(errno) << "\n";
+    shm_unlink(_name.c_str());
+    return false;
+  }
+  this->data = static_cast<uint8_t *>(addr);
+
+  // The object is zero filled, so every slot starts with sequence 0
+  this->header = new (this->data) TelemetryHeader();
+  this->header->version = kTelemetryVersion;
+  this->header->mode = _mode;
+  this->header->decimation = _decimation;
+  this->header->capacity = _capacity;
+  this->header->slotSize = slotSize;
+  this->header->numActuators = _numActuators;
+  this->header->recordSize = this->layout.recordSize;
+  this->header->motorOffset = this->layout.motorOffset;
+  this->header->stateOffset = this->layout.stateOffset;
+  this->header->forceOffset = this->layout.forceOffset;
+  this->header->layoutVersion = kFlightLogVersion;
+  this->header->published.store(0, std::memory_order_relaxed);
+  // Readers check the magic last
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(this->header->magic, kTelemetryMagic, sizeof(kTelemetryMagic));
+
+  gzmsg << "Publishing telemetry to shared memory " << _name << "\n";
+  return true;
+}
+
+/////////////////////////////////////////////////
+void TelemetryTap::Close()
+{
+  if (!this->data)
+  {
+    return;
+  }
+  munmap(this->data, this->size);
+  shm_unlink(this->name.c_str());
+  this->data = nullptr;
+  this->header = nullptr;
+}
+
+/////////////////////////////////////////////////
+bool TelemetryTap::IsOpen() const
+{
+  return this->data != nullptr;
+}
+
+/////////////////////////////////////////////////
+uint32_t TelemetryTap::NumActuators() const
+{
+  return this->layout.numActuators;
+}
+
+/////////////////////////////////////////////////
+void TelemetryTap::Publish(const uint64_t _step,
+    const gymfc::msgs::Action &_action, const gymfc::msgs::State &_state,
+    const double _simTime, const double _force[3])
+{
+  if (!this->data)
+  {
+    return;
+  }
+  this->windowCount++;
+
+  if (this->mode == TELEMETRY_SAMPLE)
+  {
+    if (this->windowCount < this->decimation)
+    {
+      return;
+    }
+    this->windowCount = 0;
+    this->layout.Encode(_step, _action, _state, _simTime, _force,
+        this->record.data());
+    this->Write(this->record.data());
+    return;
+  }
+
+  // Floats run from the motors to the end of the state, then three doubles.
+  // The doubles are only 4 byte aligned for some actuator counts, so they
+  // are copied in and out rather than accessed in place.
+  const uint32_t recordSize = this->layout.recordSize;
+  const uint32_t numFloats =
+    (this->layout.forceOffset - this->layout.motorOffset) / sizeof(float);
+  this->layout.Encode(_step, _action, _state, _simTime, _force,
+      this->record.data());
+  const float *value = reinterpret_cast<const float *>(
+      this->record.data() + this->layout.motorOffset);
+  float *minimum = reinterpret_cast<float *>(
+      this->stats.data() + this->layout.motorOffset);
+  float *maximum = reinterpret_cast<float *>(
+      this->stats.data() + recordSize + this->layout.motorOffset);
+  float *sum = reinterpret_cast<float *>(
+      this->stats.data() + 2 * recordSize + this->layout.motorOffset);
+  const uint8_t *force = this->record.data() + this->layout.forceOffset;
+  uint8_t *minimumForce = this->stats.data() + this->layout.forceOffset;
+  uint8_t *maximumForce = minimumForce + recordSize;
+  uint8_t *sumForce = minimumForce + 2 * recordSize;
+
+  if (this->windowCount == 1)
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      memcpy(this->stats.data() + i * recordSize, this->record.data(),
+          recordSize);
+    }
+  }
+  else
+  {
+    for (uint32_t i = 0; i < numFloats; i++)
+    {
+      minimum[i] = std::min(minimum[i], value[i]);
+      maximum[i] = std::max(maximum[i], value[i]);
+      sum[i] += value[i];
+    }
+    for (uint32_t offset = 0; offset < 3 * sizeof(double);
+        offset += sizeof(double))
+    {
+      double axis, low, high, total;
+      memcpy(&axis, force + offset, sizeof(double));
+      memcpy(&low, minimumForce + offset, sizeof(double));
+      memcpy(&high, maximumForce + offset, sizeof(double));
+      memcpy(&total, sumForce + offset, sizeof(double));
+      low = std::min(low, axis);
+      high = std::max(high, axis);
+      total += axis;
+      memcpy(minimumForce + offset, &low, sizeof(double));
+      memcpy(maximumForce + offset, &high, sizeof(double));
+      memcpy(sumForce + offset, &total, sizeof(double));
+    }
+  }
+
+  if (this->windowCount < this->decimation)
+  {
+    return;
+  }
+
+  for (uint32_t i = 0; i < numFloats; i++)
+  {
+    sum[i] /= this->windowCount;
+  }
+  for (uint32_t offset = 0; offset < 3 * sizeof(double);
+      offset += sizeof(double))
+  {
+    double total;
+    memcpy(&total, sumForce + offset, sizeof(double));
+    total /= this->windowCount;
+    memcpy(sumForce + offset, &total, sizeof(double));
+  }
+  // Stamp all three with the last step of the window
+  for (int i = 0; i < 3; i++)
+  {
+    memcpy(this->stats.data() + i * recordSize, this->record.data(),
+        this->layout.motorOffset);
+  }
+  this->windowCount = 0;
+  this->Write(this->stats.data());
+}
+
+/////////////////////////////////////////////////
+void TelemetryTap::Write(const uint8_t *_payload)
+{
+  uint64_t k = this->header->published.load(std::memory_order_relaxed);
+  uint8_t *slotData = this->data + sizeof(TelemetryHeader) +
+    (k % this->header->capacity) * this->header->slotSize;
+  TelemetrySlot *slot = reinterpret_cast<TelemetrySlot *>(slotData);
+
+  slot->sequence.store(2 * k + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(slotData + sizeof(TelemetrySlot), _payload,
+      this->header->slotSize - sizeof(TelemetrySlot));
+  slot->sequence.store(2 * k + 2, std::memory_order_release);
+  this->header->published.store(k + 1, std::memory_order_release);
+}
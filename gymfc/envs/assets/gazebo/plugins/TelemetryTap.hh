@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GAZEBO_PLUGINS_TELEMETRYTAP_HH_
+#define GAZEBO_PLUGINS_TELEMETRYTAP_HH_
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "FlightRecorder.hh"
+
+namespace gazebo
+{
+  static const char kTelemetryMagic[8] = {'G', 'Y', 'M', 'F', 'C', 'T', 'L', 'M'};
+  static const uint32_t kTelemetryVersion = 1;
+
+  /// \brief Kind of records published by the telemetry tap
+  enum TelemetryMode : uint32_t
+  {
+    /// \brief Every Nth step
+    TELEMETRY_SAMPLE = 0,
+    /// \brief Minimum, maximum and mean of every window of N steps
+    TELEMETRY_STATS = 1
+  };
+
+  /// \brief Header at the start of the telemetry shared memory object,
+  // followed by capacity slots of slotSize bytes. Values are stored in
+  // host byte order.
+  struct TelemetryHeader
+  {
+    char magic[8];
+    uint32_t version;
+    uint32_t mode;
+    uint32_t decimation;
+    uint32_t capacity;
+    uint32_t slotSize;
+
+    /// \brief Flight log layout of the records, see FlightLogLayout
+    uint32_t numActuators;
+    uint32_t recordSize;
+    uint32_t motorOffset;
+    uint32_t stateOffset;
+    uint32_t forceOffset;
+
+    /// \brief Number of slots published so far, slot i of the ring holds
+    // publication i modulo capacity
+    std::atomic<uint64_t> published;
+
+    /// \brief kFlightLogVersion of the records
+    uint32_t layoutVersion;
+    uint8_t reserved[12];
+  };
+
+  /// \brief A slot starts with a sequence number, odd while the writer
+  // is copying publication k into it (2k + 1) and even once done
+  // (2k + 2). In sample mode a slot holds one flight log record, in stats
+  // mode three records with the minimum, maximum and mean of the window.
+  // The step, time and codes of every record are those of the last step
+  // of the window.
+  struct TelemetrySlot
+  {
+    std::atomic<uint64_t> sequence;
+    uint64_t reserved;
+  };
+
+  /// \brief Publishes decimated steps to a single producer ring in POSIX
+  // shared memory. Readers never block the step thread, they copy a slot
+  // and check its sequence number did not change while copying.
+  class TelemetryTap
+  {
+    /// \brief Destructor.
+    public: ~TelemetryTap();
+
+    /// \brief Create the shared memory object, replacing any previous one
+    // with the same name
+    /// \param[in] _name Shared memory object name, e.g. /gymfc_9005
+    /// \return True if the ring was created
+    public: bool Open(const std::string &_name, const uint32_t _numActuators,
+                const TelemetryMode _mode, const uint32_t _decimation,
+                const uint32_t _capacity);
+
+    /// \brief Unmap and remove the shared memory object
+    public: void Close();
+
+    public: bool IsOpen() const;
+
+    public: uint32_t NumActuators() const;
+
+    /// \brief Account for a step, publishing it or its window when due
+    public: void Publish(const uint64_t _step,
+                const gymfc::msgs::Action &_action,
+                const gymfc::msgs::State &_state, const double _simTime,
+                const double _force[3]);
+
+    /// \brief Copy the payload into the next slot
+    private: void Write(const uint8_t *_payload);
+
+    private: std::string name;
+    private: FlightLogLayout layout;
+    private: TelemetryMode mode = TELEMETRY_SAMPLE;
+    private: uint32_t decimation = 1;
+
+    private: uint8_t *data = nullptr;
+    private: size_t size = 0;
+    private: TelemetryHeader *header = nullptr;
+
+    /// \brief Steps seen in the current window
+    private: uint32_t windowCount = 0;
+
+    /// \brief Reused encoded step and, in stats mode, the minimum,
+    // maximum and sum records of the window
+    private: std::vector<uint8_t> record;
+    private: std::vector<uint8_t> stats;
+  };
+}
+#endif
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <cstdlib>
+#include <cstring>
+#include <pthread.h>
+#include <sched.h>
+
+#include <boost/algorithm/string.hpp>
+#include <gazebo/common/common.hh>
+
+#include "ThreadPlacement.hh"
+
+using namespace gazebo;
+
+/////////////////////////////////////////////////
+/// \brief Parse a non-negative CPU index
+static bool ParseCpu(const std::string &_s, int &_cpu)
+{
+  char *end = nullptr;
+  long value = strtol(_s.c_str(), &end, 10);
+  if (_s.empty() || *end != '\0' || value < 0 || value >= CPU_SETSIZE)
+  {
+    return false;
+  }
+  _cpu = static_cast<int>(value);
+  return true;
+}
+
+/////////////////////////////////////////////////
+ThreadPlacement::ThreadPlacement(const std::string &_name)
+  : name(_name)
+{
+}
+
+/////////////////////////////////////////////////
+bool ThreadPlacement::SetCpus(const std::string &_cpus)
+{
+  this->cpus.clear();
+  std::vector<std::string> ranges;
+  boost::split(ranges, _cpus, boost::is_any_of(","));
+  for (auto &range : ranges)
+  {
+    boost::trim(range);
+    if (range.empty())
+    {
+      continue;
+    }
+    size_t dash = range.find('-');
+    int first, last;
+    if (!ParseCpu(range.substr(0, dash), first) ||
+        !ParseCpu(dash == std::string::npos ? range.substr(0, dash) :
+          range.substr(dash + 1), last) || last < first)
+    {
+      gzerr << "Invalid CPU list " << _cpus << " for the " << this->name << " thread\n";
+      this->cpus.clear();
+      return false;
+    }
+    for (int cpu = first; cpu <= last; cpu++)
+    {
+      this->cpus.push_back(cpu);
+    }
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////
+void ThreadPlacement::SetPriority(const int _priority)
+{
+  this->priority = _priority;
+}
+
+/////////////////////////////////////////////////
+bool ThreadPlacement::Requested() const
+{
+  return !this->cpus.empty() || this->priority > 0;
+}
+
+/////////////////////////////////////////////////
+bool ThreadPlacement::Apply()
+{
+  bool ok = true;
+  pthread_t thread = pthread_self();
+
+  if (!this->cpus.empty())
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : this->cpus)
+    {
+      CPU_SET(cpu, &set);
+    }
+    int err = pthread_setaffinity_np(thread, sizeof(set), &set);
+    if (err != 0)
+    {
+      gzerr << "Could not pin the " << this->name << " thread, " << strerror(err) << "\n";
+      ok = false;
+    }
+  }
+
+  if (this->priority > 0)
+  {
+    struct sched_param param;
+    param.sched_priority = this->priority;
+    int err = pthread_setschedparam(thread, SCHED_FIFO, &param);
+    if (err != 0)
+    {
+      // Usually missing CAP_SYS_NICE or an rtprio limit
+      gzerr << "Could not set SCHED_FIFO priority " << this->priority
+        << " for the " << this->name << " thread, " << strerror(err) << "\n";
+      ok = false;
+    }
+  }
+
+  // Read back what the kernel actually gave us
+  std::lock_guard<std::mutex> lock(this->mutex);
+  this->applied = true;
+  this->effectiveCpus.clear();
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (pthread_getaffinity_np(thread, sizeof(set), &set) == 0)
+  {
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+      if (CPU_ISSET(cpu, &set))
+      {
+        this->effectiveCpus.push_back(cpu);
+      }
+    }
+  }
+  int policy;
+  struct sched_param param;
+  if (pthread_getschedparam(thread, &policy, &param) == 0)
+  {
+    this->effectiveRealtime = policy == SCHED_FIFO;
+    this->effectivePriority = param.sched_priority;
+  }
+  return ok;
+}
+
+/////////////////////////////////////////////////
+void ThreadPlacement::Fill(gymfc::msgs::State::ThreadPlacement &_msg) const
+{
+  std::lock_guard<std::mutex> lock(this->mutex);
+  _msg.set_name(this->name);
+  _msg.set_applied(this->applied);
+  _msg.clear_cpus();
+  for (int cpu : this->effectiveCpus)
+  {
+    _msg.add_cpus(cpu);
+  }
+  _msg.set_realtime(this->effectiveRealtime);
+  _msg.set_priority(this->effectivePriority);
+}
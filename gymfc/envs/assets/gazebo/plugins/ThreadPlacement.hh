@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GAZEBO_PLUGINS_THREADPLACEMENT_HH_
+#define GAZEBO_PLUGINS_THREADPLACEMENT_HH_
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "State.pb.h"
+
+namespace gazebo
+{
+  /// \brief CPU affinity and scheduling policy requested for a thread of
+  // the simulator, along with the placement the thread actually ended up
+  // with after applying it.
+  class ThreadPlacement
+  {
+    /// \brief Constructor.
+    /// \param[in] _name Name the thread is reported as
+    public: explicit ThreadPlacement(const std::string &_name);
+
+    /// \brief Set the CPUs from a list such as "0,2-3". An empty list
+    // leaves the affinity unchanged.
+    /// \return False if the list could not be parsed
+    public: bool SetCpus(const std::string &_cpus);
+
+    /// \brief Run the thread with SCHED_FIFO at the given priority, 0
+    // keeps the default policy
+    public: void SetPriority(const int _priority);
+
+    /// \brief True if a CPU list or priority was requested
+    public: bool Requested() const;
+
+    /// \brief Apply the placement to the calling thread and read back
+    // the effective placement
+    /// \return False if the affinity or policy could not be set
+    public: bool Apply();
+
+    /// \brief Report the effective placement of the last Apply
+    public: void Fill(gymfc::msgs::State::ThreadPlacement &_msg) const;
+
+    private: std::string name;
+    private: std::vector<int> cpus;
+    private: int priority = 0;
+
+    /// \brief Effective placement, written by the placed thread
+    private: mutable std::mutex mutex;
+    private: bool applied = false;
+    private: std::vector<int> effectiveCpus;
+    private: bool effectiveRealtime = false;
+    private: int effectivePriority = 0;
+  };
+}
+#endif
@@ -0,0 +1,271 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "FlightRecorder.hh"
+
+using namespace gazebo;
+
+static const uint32_t kNumActuators = 4;
+
+/////////////////////////////////////////////////
+/// \brief State with every recorded field set to a distinct value
+static gymfc::msgs::State MakeState(const float _base)
+{
+  gymfc::msgs::State state;
+  state.set_sim_time(_base);
+  state.set_status_code(gymfc::msgs::State_StatusCode_OK);
+  for (int i = 0; i < 3; i++)
+  {
+    state.add_imu_angular_velocity_rpy(_base + 1 + i);
+    state.add_imu_linear_acceleration_xyz(_base + 4 + i);
+    state.add_setpoint(_base + 20 + i);
+  }
+  for (int i = 0; i < 4; i++)
+  {
+    state.add_imu_orientation_quat(_base + 7 + i);
+  }
+  for (uint32_t i = 0; i < kNumActuators; i++)
+  {
+    state.add_esc_motor_angular_velocity(_base + 11 + i);
+    state.add_esc_temperature(_base + 12 + i);
+    state.add_esc_current(_base + 13 + i);
+    state.add_esc_voltage(_base + 14 + i);
+    state.add_esc_force(_base + 15 + i);
+    state.add_esc_torque(_base + 16 + i);
+  }
+  state.set_vbat_voltage(_base + 17);
+  state.set_vbat_current(_base + 18);
+  state.set_vbat_state_of_charge(0.5);
+  state.set_reward(-_base);
+  state.set_done(true);
+  state.set_termination(5);
+  state.set_link_drift(0.25);
+  return state;
+}
+
+/////////////////////////////////////////////////
+static gymfc::msgs::Action MakeAction(const float _base)
+{
+  gymfc::msgs::Action action;
+  action.set_world_control(gymfc::msgs::Action::STEP);
+  for (uint32_t i = 0; i < kNumActuators; i++)
+  {
+    action.add_motor(_base + 0.1f * i);
+  }
+  return action;
+}
+
+/////////////////////////////////////////////////
+static float ReadFloat(const uint8_t *_record, const uint32_t _offset)
+{
+  float value;
+  memcpy(&value, _record + _offset, sizeof(value));
+  return value;
+}
+
+/////////////////////////////////////////////////
+TEST(FlightLogLayout, EncodeDecodeAction)
+{
+  FlightLogLayout layout(kNumActuators);
+  EXPECT_EQ(0u, layout.recordSize % 8);
+
+  gymfc::msgs::Action action = MakeAction(0.5);
+  action.set_world_control(gymfc::msgs::Action::RESET);
+  action.set_randomize(true);
+  action.set_seed(42);
+  action.add_target_rate(1);
+  action.add_target_rate(-2);
+  action.add_target_rate(3);
+  gymfc::msgs::State state = MakeState(1);
+  double force[3] = {0.5, -1.5, 2.5};
+
+  std::vector<uint8_t> record(layout.recordSize, 0xff);
+  layout.Encode(7, action, state, 1.25, force, record.data());
+
+  gymfc::msgs::Action decoded;
+  layout.DecodeAction(record.data(), decoded);
+  EXPECT_EQ(action.world_control(), decoded.world_control());
+  EXPECT_TRUE(decoded.randomize());
+  ASSERT_TRUE(decoded.has_seed());
+  EXPECT_EQ(42u, decoded.seed());
+  ASSERT_EQ(3, decoded.target_rate_size());
+  EXPECT_FLOAT_EQ(-2, decoded.target_rate(1));
+  ASSERT_EQ(static_cast<int>(kNumActuators), decoded.motor_size());
+  for (uint32_t i = 0; i < kNumActuators; i++)
+  {
+    EXPECT_FLOAT_EQ(action.motor(i), decoded.motor(i));
+  }
+
+  uint64_t step;
+  double simTime;
+  uint32_t done[2];
+  memcpy(&step, record.data() + layout.stepOffset, sizeof(step));
+  memcpy(&simTime, record.data() + layout.simTimeOffset, sizeof(simTime));
+  memcpy(done, record.data() + layout.doneOffset, sizeof(done));
+  EXPECT_EQ(7u, step);
+  EXPECT_DOUBLE_EQ(1.25, simTime);
+  EXPECT_EQ(1u, done[0]);
+  EXPECT_EQ(5u, done[1]);
+
+  // The state ends with the battery, setpoint, reward and link drift
+  const uint32_t end = layout.stateOffset + layout.stateSize;
+  EXPECT_EQ(layout.forceOffset, end);
+  EXPECT_FLOAT_EQ(state.imu_angular_velocity_rpy(0),
+      ReadFloat(record.data(), layout.stateOffset));
+  EXPECT_FLOAT_EQ(0.25, ReadFloat(record.data(), end - 4));
+  EXPECT_FLOAT_EQ(-1, ReadFloat(record.data(), end - 8));
+  EXPECT_FLOAT_EQ(state.setpoint(2), ReadFloat(record.data(), end - 12));
+  EXPECT_FLOAT_EQ(0.5, ReadFloat(record.data(), end - 24));
+
+  double decodedForce[3];
+  memcpy(decodedForce, record.data() + layout.forceOffset,
+      sizeof(decodedForce));
+  for (int i = 0; i < 3; i++)
+  {
+    EXPECT_DOUBLE_EQ(force[i], decodedForce[i]);
+  }
+
+  // Padding is zeroed so records compare byte for byte
+  for (uint32_t i = layout.forceOffset + 3 * sizeof(double);
+      i < layout.recordSize; i++)
+  {
+    EXPECT_EQ(0, record[i]);
+  }
+}
+
+/////////////////////////////////////////////////
+TEST(FlightLogLayout, DecodeActionWithoutOptionalValues)
+{
+  FlightLogLayout layout(kNumActuators);
+  gymfc::msgs::Action action = MakeAction(0.25);
+  double force[3] = {0, 0, 0};
+  std::vector<uint8_t> record(layout.recordSize);
+  layout.Encode(0, action, MakeState(0), 0, force, record.data());
+
+  // Values of a previously decoded action must not leak into this one
+  gymfc::msgs::Action decoded;
+  decoded.set_seed(3);
+  decoded.add_target_rate(1);
+  decoded.set_randomize(true);
+  layout.DecodeAction(record.data(), decoded);
+  EXPECT_FALSE(decoded.randomize());
+  EXPECT_FALSE(decoded.has_seed());
+  EXPECT_EQ(0, decoded.target_rate_size());
+  EXPECT_EQ(static_cast<int>(kNumActuators), decoded.motor_size());
+}
+
+/////////////////////////////////////////////////
+class FlightRecorderTest : public ::testing::Test
+{
+  protected: virtual void SetUp()
+  {
+    char dir[] = "/tmp/gymfc_flightlog_XXXXXX";
+    ASSERT_NE(nullptr, mkdtemp(dir));
+    this->dir = dir;
+    this->prefix = this->dir + "/log";
+  }
+
+  protected: virtual void TearDown()
+  {
+    for (int i = 0; i < 8; i++)
+    {
+      std::remove((this->prefix + "." + std::to_string(i)).c_str());
+    }
+    std::remove((this->prefix + ".twins").c_str());
+    rmdir(this->dir.c_str());
+  }
+
+  protected: std::string dir;
+  protected: std::string prefix;
+};
+
+/////////////////////////////////////////////////
+TEST_F(FlightRecorderTest, RejectsEmptySegments)
+{
+  FlightRecorder recorder;
+  EXPECT_FALSE(recorder.Open(this->prefix, kNumActuators, 0));
+  EXPECT_FALSE(recorder.IsOpen());
+}
+
+/////////////////////////////////////////////////
+TEST_F(FlightRecorderTest, ReadBackAcrossSegments)
+{
+  // Three records per segment, the log spans three segments
+  const uint64_t numRecords = 8;
+  const uint64_t twinStep = 4;
+  const std::string twinPath = "/models/twin/model.sdf";
+  {
+    FlightRecorder recorder;
+    ASSERT_TRUE(recorder.Open(this->prefix, kNumActuators, 3));
+    for (uint64_t i = 0; i < numRecords; i++)
+    {
+      gymfc::msgs::Action action = MakeAction(i);
+      if (i == twinStep)
+      {
+        action.set_world_control(gymfc::msgs::Action::LOAD_DIGITAL_TWIN);
+        action.set_digital_twin_sdf(twinPath);
+      }
+      double force[3] = {static_cast<double>(i), 0, 0};
+      recorder.Record(action, MakeState(i), 0.001 * i, force);
+    }
+    EXPECT_EQ(numRecords, recorder.Count());
+    recorder.Close();
+  }
+
+  FlightLogReader reader;
+  ASSERT_TRUE(reader.Open(this->prefix));
+  const FlightLogLayout &layout = reader.Layout();
+  EXPECT_EQ(kNumActuators, layout.numActuators);
+
+  uint64_t count = 0;
+  const uint8_t *record;
+  while ((record = reader.Next()) != nullptr)
+  {
+    uint64_t step;
+    memcpy(&step, record + layout.stepOffset, sizeof(step));
+    EXPECT_EQ(count, step);
+
+    gymfc::msgs::Action action;
+    layout.DecodeAction(record, action);
+    ASSERT_EQ(static_cast<int>(kNumActuators), action.motor_size());
+    EXPECT_FLOAT_EQ(static_cast<float>(count), action.motor(0));
+
+    std::string path;
+    if (count == twinStep)
+    {
+      EXPECT_EQ(gymfc::msgs::Action::LOAD_DIGITAL_TWIN,
+          action.world_control());
+      ASSERT_TRUE(reader.DigitalTwinSdf(record, path));
+      EXPECT_EQ(twinPath, path);
+    }
+    else
+    {
+      EXPECT_FALSE(reader.DigitalTwinSdf(record, path));
+    }
+    count++;
+  }
+  EXPECT_EQ(numRecords, count);
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#ifndef GAZEBO_PLUGINS_TEST_PLUGINSDF_HH_
+#define GAZEBO_PLUGINS_TEST_PLUGINSDF_HH_
+
+#include <string>
+
+#include <sdf/sdf.hh>
+
+namespace gazebo
+{
+  /// \brief Parse the given elements as children of a world plugin, the
+  // way the FlightControllerPlugin receives its configuration.
+  /// \return The child element with the given name, null if the SDF could
+  // not be parsed
+  inline sdf::ElementPtr PluginSdf(const std::string &_name,
+      const std::string &_xml)
+  {
+    sdf::SDFPtr sdf(new sdf::SDF());
+    sdf::init(sdf);
+    std::string doc = "<?xml version='1.0'?><sdf version='1.6'>"
+      "<world name='default'><plugin name='test' filename='test.so'>" +
+      _xml + "</plugin></world></sdf>";
+    if (!sdf::readString(doc, sdf))
+    {
+      return sdf::ElementPtr();
+    }
+    sdf::ElementPtr plugin =
+      sdf->Root()->GetElement("world")->GetElement("plugin");
+    return plugin->HasElement(_name) ? plugin->GetElement(_name) :
+      sdf::ElementPtr();
+  }
+}
+#endif
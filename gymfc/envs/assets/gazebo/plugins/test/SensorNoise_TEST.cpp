@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "PluginSdf.hh"
+#include "SensorNoise.hh"
+
+using namespace gazebo;
+
+static const char kGyroNoise[] =
+  "<sensorNoise>"
+  "  <field name='imu_angular_velocity_rpy'>"
+  "    <stddev>1</stddev>"
+  "    <biasStddev>0.1</biasStddev>"
+  "  </field>"
+  "</sensorNoise>";
+
+/////////////////////////////////////////////////
+/// \brief Reset the noise with the given seed and return the noisy gyro
+/// values of the first steps of the episode, the true rates are zero
+static std::vector<float> Episode(SensorNoise &_noise, const uint32_t _seed)
+{
+  gymfc::msgs::State state;
+  for (int i = 0; i < 3; i++)
+  {
+    state.add_imu_angular_velocity_rpy(0);
+  }
+  _noise.Seed(_seed);
+  _noise.Reset(state);
+  std::vector<float> values;
+  for (int step = 0; step < 10; step++)
+  {
+    for (int i = 0; i < 3; i++)
+    {
+      state.set_imu_angular_velocity_rpy(i, 0);
+    }
+    _noise.Apply(state, 0.001);
+    values.insert(values.end(), state.imu_angular_velocity_rpy().begin(),
+        state.imu_angular_velocity_rpy().end());
+  }
+  return values;
+}
+
+/////////////////////////////////////////////////
+TEST(SensorNoise, SeededEpisodesAreReproducibleAndDistinct)
+{
+  SensorNoise first;
+  SensorNoise second;
+  ASSERT_TRUE(first.Load(PluginSdf("sensorNoise", kGyroNoise)));
+  ASSERT_TRUE(second.Load(PluginSdf("sensorNoise", kGyroNoise)));
+  ASSERT_TRUE(first.Enabled());
+
+  std::vector<std::vector<float>> episodes;
+  for (int i = 0; i < 3; i++)
+  {
+    episodes.push_back(Episode(first, 3));
+    EXPECT_EQ(episodes.back(), Episode(second, 3));
+  }
+  // The same seed on every reset still gives every episode its own noise
+  EXPECT_NE(episodes[0], episodes[1]);
+  EXPECT_NE(episodes[1], episodes[2]);
+
+  // Another seed on the same episode index gives other noise
+  SensorNoise third;
+  ASSERT_TRUE(third.Load(PluginSdf("sensorNoise", kGyroNoise)));
+  EXPECT_NE(episodes[0], Episode(third, 4));
+}
+
+/////////////////////////////////////////////////
+TEST(SensorNoise, RejectsUnknownFields)
+{
+  SensorNoise noise;
+  EXPECT_FALSE(noise.Load(PluginSdf("sensorNoise",
+          "<sensorNoise><field name='vbat_voltage'><stddev>1</stddev>"
+          "</field></sensorNoise>")));
+  EXPECT_FALSE(noise.Enabled());
+}
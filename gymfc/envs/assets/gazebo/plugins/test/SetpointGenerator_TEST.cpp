@@ -0,0 +1,139 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "PluginSdf.hh"
+#include "SetpointGenerator.hh"
+
+using namespace gazebo;
+
+static const char kPulses[] =
+  "<setpoints>"
+  "  <profile type='pulses'>"
+  "    <duration>2</duration>"
+  "    <amplitude>6 6 3</amplitude>"
+  "    <minWidth>0.05</minWidth><maxWidth>0.2</maxWidth>"
+  "    <minGap>0.05</minGap><maxGap>0.1</maxGap>"
+  "  </profile>"
+  "</setpoints>";
+
+/////////////////////////////////////////////////
+/// \brief Reset the generator with the given seed and return the roll
+/// setpoint of every 10 ms of the episode
+static std::vector<float> Episode(SetpointGenerator &_generator,
+    const uint32_t _seed)
+{
+  gymfc::msgs::State state;
+  state.set_sim_time(0);
+  _generator.Seed(_seed);
+  _generator.Reset(state);
+  std::vector<float> roll;
+  for (int i = 0; i < 200; i++)
+  {
+    state.set_sim_time(0.01 * i);
+    _generator.Update(state);
+    roll.push_back(state.setpoint(0));
+  }
+  return roll;
+}
+
+/////////////////////////////////////////////////
+TEST(SetpointGenerator, SeedingEveryResetKeepsTheCurriculum)
+{
+  SetpointGenerator generator;
+  ASSERT_TRUE(generator.Load(PluginSdf("setpoints",
+        "<setpoints>"
+        "  <curriculum><episodes>4</episodes>"
+        "    <initialScale>0</initialScale></curriculum>"
+        "  <profile type='step'><duration>1</duration>"
+        "    <value>1 2 3</value></profile>"
+        "</setpoints>")));
+
+  gymfc::msgs::State state;
+  const float expected[] = {0, 0.25, 0.5, 0.75, 1, 1};
+  for (float scale : expected)
+  {
+    state.set_sim_time(0);
+    generator.Seed(7);
+    generator.Reset(state);
+    ASSERT_EQ(3, state.setpoint_size());
+    EXPECT_FLOAT_EQ(scale, state.setpoint(0));
+    EXPECT_FLOAT_EQ(3 * scale, state.setpoint(2));
+  }
+}
+
+/////////////////////////////////////////////////
+TEST(SetpointGenerator, SeededEpisodesAreReproducibleAndDistinct)
+{
+  SetpointGenerator first;
+  SetpointGenerator second;
+  ASSERT_TRUE(first.Load(PluginSdf("setpoints", kPulses)));
+  ASSERT_TRUE(second.Load(PluginSdf("setpoints", kPulses)));
+
+  std::vector<std::vector<float>> episodes;
+  for (int i = 0; i < 3; i++)
+  {
+    episodes.push_back(Episode(first, 7));
+    EXPECT_EQ(episodes.back(), Episode(second, 7));
+  }
+  // The same seed on every reset still draws a new schedule
+  EXPECT_NE(episodes[0], episodes[1]);
+  EXPECT_NE(episodes[1], episodes[2]);
+
+  // Another seed on the same episode index draws another schedule
+  SetpointGenerator third;
+  ASSERT_TRUE(third.Load(PluginSdf("setpoints", kPulses)));
+  EXPECT_NE(episodes[0], Episode(third, 8));
+}
+
+/////////////////////////////////////////////////
+TEST(SetpointGenerator, RejectsInvalidProfiles)
+{
+  const char *invalid[] = {
+    // Missing value
+    "<setpoints><profile type='step'><duration>1</duration></profile>"
+    "</setpoints>",
+    // Missing duration
+    "<setpoints><profile type='step'><value>1 0 0</value></profile>"
+    "</setpoints>",
+    // Negative width
+    "<setpoints><profile type='pulses'><duration>1</duration>"
+    "<amplitude>1 1 1</amplitude><minWidth>-0.1</minWidth>"
+    "<maxWidth>0.2</maxWidth><minGap>0.1</minGap><maxGap>0.2</maxGap>"
+    "</profile></setpoints>",
+    // Missing gap
+    "<setpoints><profile type='pulses'><duration>1</duration>"
+    "<amplitude>1 1 1</amplitude><minWidth>0.1</minWidth>"
+    "<maxWidth>0.2</maxWidth><minGap>0.1</minGap></profile></setpoints>",
+    // Negative curriculum episodes
+    "<setpoints><curriculum><episodes>-5</episodes>"
+    "<initialScale>0.5</initialScale></curriculum>"
+    "<profile type='step'><duration>1</duration><value>1 0 0</value>"
+    "</profile></setpoints>",
+    // No profile
+    "<setpoints><repeat>true</repeat></setpoints>"
+  };
+  for (const char *xml : invalid)
+  {
+    SetpointGenerator generator;
+    EXPECT_FALSE(generator.Load(PluginSdf("setpoints", xml))) << xml;
+    EXPECT_FALSE(generator.Enabled()) << xml;
+  }
+}
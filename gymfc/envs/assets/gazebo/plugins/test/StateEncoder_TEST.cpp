@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "StateEncoder.hh"
+
+using namespace gazebo;
+
+/////////////////////////////////////////////////
+/// \brief State of a step as sent by the plugin, every value derived from
+/// the base so consecutive steps differ in every field
+static gymfc::msgs::State MakeState(const float _base)
+{
+  gymfc::msgs::State state;
+  state.set_sim_time(_base);
+  state.set_status_code(gymfc::msgs::State_StatusCode_OK);
+  for (int i = 0; i < 3; i++)
+  {
+    state.add_imu_angular_velocity_rpy(_base + i);
+    state.add_imu_linear_acceleration_xyz(_base - i);
+    state.add_force(2 * _base + i);
+    state.add_setpoint(-_base - i);
+  }
+  for (int i = 0; i < 4; i++)
+  {
+    state.add_imu_orientation_quat(0.25f * i + _base);
+    state.add_esc_motor_angular_velocity(100 * _base + i);
+    state.add_esc_current(_base / (i + 1));
+  }
+  state.set_vbat_voltage(16 - _base);
+  state.set_vbat_state_of_charge(1 - _base / 100);
+  state.set_stale_sensors(0);
+  state.set_reward(-_base);
+  state.set_done(false);
+  state.set_termination(0);
+  return state;
+}
+
+/////////////////////////////////////////////////
+/// \brief The encoded bytes parse back into the same state
+static void ExpectRoundTrip(const std::string &_encoded,
+    const gymfc::msgs::State &_state)
+{
+  gymfc::msgs::State decoded;
+  ASSERT_TRUE(decoded.ParseFromString(_encoded));
+  EXPECT_EQ(_state.SerializeAsString(), decoded.SerializeAsString());
+}
+
+/////////////////////////////////////////////////
+TEST(StateEncoder, PatchesValuesInPlace)
+{
+  StateEncoder encoder;
+  for (int step = 0; step < 10; step++)
+  {
+    gymfc::msgs::State state = MakeState(0.5f * step);
+    ExpectRoundTrip(encoder.Encode(state), state);
+  }
+  // Only the values changed, the first template is reused throughout
+  EXPECT_EQ(1u, encoder.Builds());
+}
+
+/////////////////////////////////////////////////
+TEST(StateEncoder, RebuildsWhenTheLayoutChanges)
+{
+  StateEncoder encoder;
+  gymfc::msgs::State state = MakeState(1);
+  ExpectRoundTrip(encoder.Encode(state), state);
+
+  // A field appears
+  state.set_link_drift(0.125);
+  ExpectRoundTrip(encoder.Encode(state), state);
+  EXPECT_EQ(2u, encoder.Builds());
+
+  // A varint needs more bytes
+  state.set_done(true);
+  state.set_termination(300);
+  ExpectRoundTrip(encoder.Encode(state), state);
+  EXPECT_EQ(3u, encoder.Builds());
+
+  // A packed field changes size
+  state.add_esc_current(1);
+  ExpectRoundTrip(encoder.Encode(state), state);
+  EXPECT_EQ(4u, encoder.Builds());
+
+  // A field disappears
+  state.clear_setpoint();
+  ExpectRoundTrip(encoder.Encode(state), state);
+  EXPECT_EQ(5u, encoder.Builds());
+
+  // Same layout again, patched
+  state.set_sim_time(2);
+  state.set_termination(301);
+  ExpectRoundTrip(encoder.Encode(state), state);
+  EXPECT_EQ(5u, encoder.Builds());
+}
+
+/////////////////////////////////////////////////
+TEST(StateEncoder, SerializesTheInfo)
+{
+  StateEncoder encoder;
+  gymfc::msgs::State state = MakeState(1);
+  ExpectRoundTrip(encoder.Encode(state), state);
+
+  gymfc::msgs::State info = state;
+  info.mutable_info()->set_motor_count(4);
+  info.mutable_info()->add_fields("imu_angular_velocity_rpy");
+  ExpectRoundTrip(encoder.Encode(info), info);
+
+  // The following step goes back to a template
+  state.set_sim_time(3);
+  ExpectRoundTrip(encoder.Encode(state), state);
+}
@@ -0,0 +1,436 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+/// \brief Native client that speaks the Action/State protocol of the
+/// FlightControllerPlugin and drives one or more gzserver instances as
+/// fast as they will respond. Used to measure the real steps per second
+/// ceiling of the plugin, which the Python client cannot saturate.
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "State.pb.h"
+#include "Action.pb.h"
+
+typedef std::chrono::steady_clock Clock;
+
+/// \brief Options shared by all of the load generating workers
+struct Options
+{
+  std::string host = "127.0.0.1";
+  std::vector<uint16_t> ports;
+  unsigned int numMotors = 4;
+  unsigned int steps = 10000;
+  unsigned int resetEvery = 0;
+  int timeoutMs = 1000;
+  float minCommand = 0;
+  float maxCommand = 1;
+  unsigned int seed = 0;
+  std::vector<std::vector<float>> script;
+};
+
+/// \brief Measurements collected by a single worker
+struct Result
+{
+  uint16_t port = 0;
+  unsigned int steps = 0;
+  unsigned int resets = 0;
+  unsigned int drops = 0;
+  unsigned int outOfOrder = 0;
+  double elapsed = 0;
+  std::vector<double> stepLatency;
+  std::vector<double> resetLatency;
+};
+
+/////////////////////////////////////////////////
+void Usage(const char *_name)
+{
+  std::cerr << "Usage: " << _name << " [options]\n"
+    << "  --host <addr>         Plugin address (default 127.0.0.1)\n"
+    << "  --port <port>         Plugin port, may be repeated\n"
+    << "  --ports <begin-end>   Inclusive range of plugin ports\n"
+    << "  --motors <n>          Number of motors (default 4)\n"
+    << "  --steps <n>           Steps per instance (default 10000)\n"
+    << "  --reset-every <n>     Reset every n steps, 0 only resets at start\n"
+    << "  --timeout-ms <ms>     Time to wait for a state (default 1000)\n"
+    << "  --range <min> <max>   Range of random motor commands (default 0 1)\n"
+    << "  --seed <n>            Seed of the random motor commands\n"
+    << "  --script <file>       Motor commands, one step per line, cycled\n";
+}
+
+/////////////////////////////////////////////////
+bool LoadScript(const std::string &_path, const unsigned int _numMotors,
+    std::vector<std::vector<float>> &_script)
+{
+  std::ifstream in(_path);
+  if (!in)
+  {
+    std::cerr << "Could not open script " << _path << std::endl;
+    return false;
+  }
+  std::string line;
+  while (std::getline(in, line))
+  {
+    if (line.empty() || line[0] == '#')
+    {
+      continue;
+    }
+    std::replace(line.begin(), line.end(), ',', ' ');
+    std::istringstream ss(line);
+    std::vector<float> motor;
+    float value;
+    while (ss >> value)
+    {
+      motor.push_back(value);
+    }
+    if (motor.size() != _numMotors)
+    {
+      std::cerr << "Script line has " << motor.size() << " values, expected "
+        << _numMotors << std::endl;
+      return false;
+    }
+    _script.push_back(motor);
+  }
+  return !_script.empty();
+}
+
+/////////////////////////////////////////////////
+bool ParseArgs(int _argc, char **_argv, Options &_options)
+{
+  std::string scriptPath;
+  for (int i = 1; i < _argc; i++)
+  {
+    std::string arg(_argv[i]);
+    bool hasValue = i + 1 < _argc;
+    if (arg == "--host" && hasValue)
+    {
+      _options.host = _argv[++i];
+    }
+    else if (arg == "--port" && hasValue)
+    {
+      _options.ports.push_back(std::stoi(_argv[++i]));
+    }
+    else if (arg == "--ports" && hasValue)
+    {
+      std::string range(_argv[++i]);
+      size_t dash = range.find('-');
+      if (dash == std::string::npos)
+      {
+        return false;
+      }
+      int begin = std::stoi(range.substr(0, dash));
+      int end = std::stoi(range.substr(dash + 1));
+      for (int port = begin; port <= end; port++)
+      {
+        _options.ports.push_back(port);
+      }
+    }
+    else if (arg == "--motors" && hasValue)
+    {
+      _options.numMotors = std::stoi(_argv[++i]);
+    }
+    else if (arg == "--steps" && hasValue)
+    {
+      _options.steps = std::stoi(_argv[++i]);
+    }
+    else if (arg == "--reset-every" && hasValue)
+    {
+      _options.resetEvery = std::stoi(_argv[++i]);
+    }
+    else if (arg == "--timeout-ms" && hasValue)
+    {
+      _options.timeoutMs = std::stoi(_argv[++i]);
+    }
+    else if (arg == "--range" && i + 2 < _argc)
+    {
+      _options.minCommand = std::stof(_argv[++i]);
+      _options.maxCommand = std::stof(_argv[++i]);
+    }
+    else if (arg == "--seed" && hasValue)
+    {
+      _options.seed = std::stoi(_argv[++i]);
+    }
+    else if (arg == "--script" && hasValue)
+    {
+      scriptPath = _argv[++i];
+    }
+    else
+    {
+      return false;
+    }
+  }
+
+  if (_options.ports.empty())
+  {
+    _options.ports.push_back(9002);
+  }
+  if (!scriptPath.empty() &&
+      !LoadScript(scriptPath, _options.numMotors, _options.script))
+  {
+    return false;
+  }
+  return true;
+}
+
+/////////////////////////////////////////////////
+/// \brief Send the action and block until a state is received or the
+/// timeout expires.
+/// \return True if a state was received
+bool Exchange(int _handle, const gymfc::msgs::Action &_action,
+    gymfc::msgs::State &_state, const int _timeoutMs)
+{
+  std::string buf;
+  _action.SerializeToString(&buf);
+  if (send(_handle, buf.data(), buf.size(), 0) < 0)
+  {
+    return false;
+  }
+
+  struct pollfd pfd;
+  pfd.fd = _handle;
+  pfd.events = POLLIN;
+  if (poll(&pfd, 1, _timeoutMs) <= 0)
+  {
+    return false;
+  }
+
+  char recvBuf[65536];
+  ssize_t recvSize = recv(_handle, recvBuf, sizeof(recvBuf), 0);
+  if (recvSize < 0)
+  {
+    return false;
+  }
+  return _state.ParseFromArray(recvBuf, recvSize);
+}
+
+/////////////////////////////////////////////////
+/// \brief Discard any late replies so they are not mistaken for the
+/// response of the next action.
+void Drain(int _handle)
+{
+  char buf[65536];
+  while (recv(_handle, buf, sizeof(buf), MSG_DONTWAIT) > 0)
+  {
+  }
+}
+
+/////////////////////////////////////////////////
+void Worker(const Options &_options, const unsigned int _index,
+    Result &_result)
+{
+  uint16_t port = _options.ports[_index];
+  _result.port = port;
+
+  int handle = socket(AF_INET, SOCK_DGRAM, 0);
+  struct sockaddr_in sockaddr;
+  memset(&sockaddr, 0, sizeof(sockaddr));
+  sockaddr.sin_family = AF_INET;
+  sockaddr.sin_port = htons(port);
+  sockaddr.sin_addr.s_addr = inet_addr(_options.host.c_str());
+  if (connect(handle, (struct sockaddr *)&sockaddr, sizeof(sockaddr)) != 0)
+  {
+    std::cerr << "Could not connect to " << _options.host << ":" << port
+      << std::endl;
+    close(handle);
+    return;
+  }
+
+  std::mt19937 rng(_options.seed + _index);
+  std::uniform_real_distribution<float> command(_options.minCommand,
+      _options.maxCommand);
+
+  gymfc::msgs::Action action;
+  gymfc::msgs::State state;
+  for (unsigned int i = 0; i < _options.numMotors; i++)
+  {
+    action.add_motor(0);
+  }
+  _result.stepLatency.reserve(_options.steps);
+
+  float lastSimTime = -1;
+  unsigned int sinceReset = 0;
+  // A dropped reset is sent again with the same timeout as a step until it
+  // is answered, stepping without one would only time out
+  bool resetPending = true;
+  Clock::time_point start = Clock::now();
+  for (unsigned int step = 0; step < _options.steps; step++)
+  {
+    bool reset = resetPending ||
+      (_options.resetEvery > 0 && sinceReset >= _options.resetEvery);
+    if (reset)
+    {
+      action.set_world_control(gymfc::msgs::Action::RESET);
+    }
+    else
+    {
+      action.set_world_control(gymfc::msgs::Action::STEP);
+      for (unsigned int i = 0; i < _options.numMotors; i++)
+      {
+        if (_options.script.empty())
+        {
+          action.set_motor(i, command(rng));
+        }
+        else
+        {
+          const std::vector<float> &line =
+            _options.script[step % _options.script.size()];
+          action.set_motor(i, line[i]);
+        }
+      }
+    }
+
+    Clock::time_point sent = Clock::now();
+    if (!Exchange(handle, action, state, _options.timeoutMs))
+    {
+      _result.drops++;
+      Drain(handle);
+      continue;
+    }
+    double latency = std::chrono::duration<double>(Clock::now() - sent).count();
+
+    if (reset)
+    {
+      resetPending = false;
+      sinceReset = 0;
+      _result.resets++;
+      _result.resetLatency.push_back(latency);
+    }
+    else
+    {
+      _result.steps++;
+      sinceReset++;
+      _result.stepLatency.push_back(latency);
+      // The sim time must always advance on a step, otherwise we
+      // received a reply meant for an earlier action
+      if (state.sim_time() <= lastSimTime)
+      {
+        _result.outOfOrder++;
+      }
+    }
+    lastSimTime = state.sim_time();
+  }
+  _result.elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+  close(handle);
+}
+
+/////////////////////////////////////////////////
+double Percentile(std::vector<double> &_samples, const double _p)
+{
+  if (_samples.empty())
+  {
+    return 0;
+  }
+  size_t n = std::min(_samples.size() - 1,
+      static_cast<size_t>(_p * _samples.size()));
+  std::nth_element(_samples.begin(), _samples.begin() + n, _samples.end());
+  return _samples[n];
+}
+
+/////////////////////////////////////////////////
+void Report(std::vector<Result> &_results)
+{
+  std::vector<double> stepLatency;
+  std::vector<double> resetLatency;
+  unsigned int steps = 0;
+  unsigned int drops = 0;
+  unsigned int outOfOrder = 0;
+  double elapsed = 0;
+
+  std::cout << std::fixed << std::setprecision(1);
+  for (auto &result : _results)
+  {
+    std::cout << "port " << result.port
+      << " steps=" << result.steps
+      << " steps/s=" << (result.elapsed > 0 ? result.steps / result.elapsed : 0)
+      << " drops=" << result.drops
+      << " out_of_order=" << result.outOfOrder << "\n";
+    steps += result.steps;
+    drops += result.drops;
+    outOfOrder += result.outOfOrder;
+    elapsed = std::max(elapsed, result.elapsed);
+    stepLatency.insert(stepLatency.end(), result.stepLatency.begin(),
+        result.stepLatency.end());
+    resetLatency.insert(resetLatency.end(), result.resetLatency.begin(),
+        result.resetLatency.end());
+  }
+
+  std::cout << "\nInstances        " << _results.size() << "\n"
+    << "Steps            " << steps << "\n"
+    << "Steps/s          " << (elapsed > 0 ? steps / elapsed : 0) << "\n"
+    << "Drops            " << drops << "\n"
+    << "Out of order     " << outOfOrder << "\n"
+    << std::setprecision(3)
+    << "Step p50 (us)    " << Percentile(stepLatency, 0.5) * 1e6 << "\n"
+    << "Step p99 (us)    " << Percentile(stepLatency, 0.99) * 1e6 << "\n"
+    << "Step p999 (us)   " << Percentile(stepLatency, 0.999) * 1e6 << "\n"
+    << "Reset p50 (ms)   " << Percentile(resetLatency, 0.5) * 1e3 << "\n";
+}
+
+/////////////////////////////////////////////////
+int main(int _argc, char **_argv)
+{
+  GOOGLE_PROTOBUF_VERIFY_VERSION;
+
+  Options options;
+  bool parsed = false;
+  try
+  {
+    parsed = ParseArgs(_argc, _argv, options);
+  }
+  catch (const std::exception &_e)
+  {
+    // std::stoi and std::stof throw on values that are not numbers
+    std::cerr << "Invalid argument: " << _e.what() << std::endl;
+  }
+  if (!parsed)
+  {
+    Usage(_argv[0]);
+    return 1;
+  }
+
+  std::vector<Result> results(options.ports.size());
+  std::vector<std::thread> workers;
+  for (unsigned int i = 0; i < options.ports.size(); i++)
+  {
+    workers.push_back(std::thread(Worker, std::cref(options), i,
+          std::ref(results[i])));
+  }
+  for (auto &worker : workers)
+  {
+    worker.join();
+  }
+
+  Report(results);
+  return 0;
+}
@@ -0,0 +1,288 @@
+/*
+ * Copyright (C) 2016 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+/// \brief Reads the telemetry ring the FlightControllerPlugin publishes to
+/// shared memory when GYMFC_TELEMETRY_SHM is set and prints every record
+/// as CSV. The reader only maps the ring, it never blocks the simulator.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TelemetryTap.hh"
+
+using namespace gazebo;
+
+/// \brief Command line options
+struct Options
+{
+  std::string name;
+  bool follow = false;
+  int intervalMs = 100;
+};
+
+/////////////////////////////////////////////////
+void Usage(const char *_name)
+{
+  std::cerr << "Usage: " << _name << " --name <shm> [options]\n"
+    << "  --name <shm>          Shared memory name given in GYMFC_TELEMETRY_SHM\n"
+    << "  --follow              Keep printing new records until interrupted\n"
+    << "  --interval-ms <ms>    Poll interval when following (default 100)\n";
+}
+
+/////////////////////////////////////////////////
+bool ParseArgs(int _argc, char **_argv, Options &_options)
+{
+  for (int i = 1; i < _argc; i++)
+  {
+    std::string arg(_argv[i]);
+    bool hasValue = i + 1 < _argc;
+    if (arg == "--name" && hasValue)
+    {
+      _options.name = _argv[++i];
+    }
+    else if (arg == "--follow")
+    {
+      _options.follow = true;
+    }
+    else if (arg == "--interval-ms" && hasValue)
+    {
+      _options.intervalMs = std::stoi(_argv[++i]);
+    }
+    else
+    {
+      return false;
+    }
+  }
+  return !_options.name.empty();
+}
+
+/////////////////////////////////////////////////
+/// \brief Print the column names of a record, see FlightLogLayout
+void PrintColumns(const TelemetryHeader &_header)
+{
+  const uint32_t n = _header.numActuators;
+  if (_header.mode == TELEMETRY_STATS)
+  {
+    std::cout << "stat,";
+  }
+  std::cout << "step,sim_time,world_control,status_code,action_flags,seed,"
+    << "done,termination";
+  for (uint32_t i = 0; i < n; i++)
+  {
+    std::cout << ",motor_" << i;
+  }
+  std::cout << ",target_rate_0,target_rate_1,target_rate_2";
+  const struct
+  {
+    const char *name;
+    uint32_t count;
+  } fields[] = {
+    {"imu_angular_velocity_rpy", 3}, {"imu_linear_acceleration_xyz", 3},
+    {"imu_orientation_quat", 4}, {"esc_motor_angular_velocity", n},
+    {"esc_temperature", n}, {"esc_current", n}, {"esc_voltage", n},
+    {"esc_force", n}, {"esc_torque", n}, {"vbat_voltage", 1},
+    {"vbat_current", 1}, {"vbat_state_of_charge", 1}, {"setpoint", 3},
+    {"reward", 1}, {"link_drift", 1}
+  };
+  for (auto &field : fields)
+  {
+    for (uint32_t i = 0; i < field.count; i++)
+    {
+      std::cout << "," << field.name;
+      if (field.count > 1)
+      {
+        std::cout << "_" << i;
+      }
+    }
+  }
+  std::cout << ",force_x,force_y,force_z\n";
+}
+
+/////////////////////////////////////////////////
+void PrintRecord(const TelemetryHeader &_header, const uint8_t *_record,
+    const char *_stat)
+{
+  uint64_t step;
+  double simTime;
+  uint32_t codes[6];
+  memcpy(&step, _record, sizeof(step));
+  memcpy(&simTime, _record + sizeof(step), sizeof(simTime));
+  memcpy(codes, _record + sizeof(step) + sizeof(simTime), sizeof(codes));
+  if (_stat)
+  {
+    std::cout << _stat << ",";
+  }
+  std::cout << step << "," << simTime;
+  for (uint32_t code : codes)
+  {
+    std::cout << "," << code;
+  }
+
+  uint32_t numFloats =
+    (_header.forceOffset - _header.motorOffset) / sizeof(float);
+  for (uint32_t i = 0; i < numFloats; i++)
+  {
+    float value;
+    memcpy(&value, _record + _header.motorOffset + i * sizeof(float),
+        sizeof(value));
+    std::cout << "," << value;
+  }
+  for (uint32_t i = 0; i < 3; i++)
+  {
+    double value;
+    memcpy(&value, _record + _header.forceOffset + i * sizeof(double),
+        sizeof(value));
+    std::cout << "," << value;
+  }
+  std::cout << "\n";
+}
+
+/////////////////////////////////////////////////
+int main(int _argc, char **_argv)
+{
+  Options options;
+  if (!ParseArgs(_argc, _argv, options))
+  {
+    Usage(_argv[0]);
+    return 1;
+  }
+
+  int fd = shm_open(options.name.c_str(), O_RDONLY, 0);
+  if (fd < 0)
+  {
+    std::cerr << "Could not open telemetry " << options.name << ", "
+      << strerror(errno) << std::endl;
+    return 1;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 ||
+      static_cast<size_t>(info.st_size) < sizeof(TelemetryHeader))
+  {
+    std::cerr << "Telemetry " << options.name << " is too small" << std::endl;
+    close(fd);
+    return 1;
+  }
+  void *addr = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED)
+  {
+    std::cerr << "Could not map telemetry " << options.name << ", "
+      << strerror(errno) << std::endl;
+    return 1;
+  }
+  const uint8_t *data = static_cast<const uint8_t *>(addr);
+  const TelemetryHeader &header =
+    *reinterpret_cast<const TelemetryHeader *>(data);
+  if (memcmp(header.magic, kTelemetryMagic, sizeof(kTelemetryMagic)) != 0 ||
+      header.version != kTelemetryVersion ||
+      header.layoutVersion != kFlightLogVersion ||
+      sizeof(TelemetryHeader) + static_cast<size_t>(header.slotSize) *
+      header.capacity > static_cast<size_t>(info.st_size))
+  {
+    std::cerr << "Telemetry " << options.name << " has an unsupported layout"
+      << std::endl;
+    return 1;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+
+  PrintColumns(header);
+  const uint32_t payloadSize = header.slotSize - sizeof(TelemetrySlot);
+  std::vector<uint8_t> payload(payloadSize);
+
+  // Start with the oldest record still in the ring
+  uint64_t published = header.published.load(std::memory_order_acquire);
+  uint64_t next = published > header.capacity ?
+    published - header.capacity : 0;
+  uint64_t missed = 0;
+  while (true)
+  {
+    published = header.published.load(std::memory_order_acquire);
+    if (published - next > header.capacity)
+    {
+      missed += published - header.capacity - next;
+      next = published - header.capacity;
+    }
+    for (; next < published; next++)
+    {
+      const uint8_t *slotData = data + sizeof(TelemetryHeader) +
+        (next % header.capacity) * header.slotSize;
+      const TelemetrySlot *slot =
+        reinterpret_cast<const TelemetrySlot *>(slotData);
+
+      // Retry until the copy is consistent or the writer lapped us
+      bool consistent = false;
+      while (!consistent)
+      {
+        uint64_t before = slot->sequence.load(std::memory_order_acquire);
+        if (before > 2 * next + 2)
+        {
+          break;
+        }
+        if (before != 2 * next + 2)
+        {
+          continue;
+        }
+        memcpy(payload.data(), slotData + sizeof(TelemetrySlot), payloadSize);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        consistent =
+          slot->sequence.load(std::memory_order_relaxed) == before;
+      }
+      if (!consistent)
+      {
+        missed++;
+        continue;
+      }
+
+      if (header.mode == TELEMETRY_STATS)
+      {
+        const char *stats[3] = {"min", "max", "mean"};
+        for (int i = 0; i < 3; i++)
+        {
+          PrintRecord(header, payload.data() + i * header.recordSize,
+              stats[i]);
+        }
+      }
+      else
+      {
+        PrintRecord(header, payload.data(), nullptr);
+      }
+    }
+    std::cout.flush();
+    if (!options.follow)
+    {
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(options.intervalMs));
+  }
+
+  if (missed > 0)
+  {
+    std::cerr << missed << " records were overwritten before they were read"
+      << std::endl;
+  }
+  munmap(addr, info.st_size);
+  return 0;
+}
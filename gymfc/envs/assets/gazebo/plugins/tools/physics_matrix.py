@@ -0,0 +1,277 @@
+"""Physics engine benchmark matrix.
+
+Replays the same recorded flight log against the same digital twin on every
+combination of physics engine and max step size, and reports the replay
+step rate, the mean reset cost and how far each trajectory diverges from
+the reference combination (the first engine at the first step size).
+
+Every run is a headless gzserver replaying the trace through the plugin
+(GYMFC_REPLAY_PATH) and recording the resulting states (GYMFC_RECORD_PATH),
+so no client or network round trip is involved. The trace is resampled for
+each step size so every action is held for the same amount of sim time it
+was recorded with, and trajectories are compared on sim time within each
+episode.
+
+Gazebo's setup.sh must be sourced beforehand and the plugins built.
+"""
+import argparse
+import os
+import re
+import struct
+import subprocess
+import sys
+import tempfile
+import xml.etree.ElementTree as ET
+
+import numpy as np
+
+MAGIC = b"GYMFCLOG"
+VERSION = 6
+# See FlightLogHeader in FlightRecorder.hh
+HEADER = struct.Struct("=8sIIIIQQ24x")
+STEP = 0
+RESET = 1
+# Offset of the motor values, see FlightLogLayout in FlightRecorder.hh
+MOTOR_OFFSET = 40
+
+STEP_RATE = re.compile(r"Replayed \d+ steps in \S+ s \((\S+) steps/s\)")
+RESET_RATE = re.compile(r"Replayed (\d+) resets in \S+ s \((\S+) ms/reset\), "
+                        r"\d+ actions at (\S+) steps/s")
+
+
+class FlightLog:
+    """All records of a flight log, see FlightLogLayout in FlightRecorder.hh"""
+
+    def __init__(self, prefix):
+        self.prefix = prefix
+        chunks = []
+        self.num_actuators = None
+        index = 0
+        while os.path.exists("{}.{}".format(prefix, index)):
+            with open("{}.{}".format(prefix, index), "rb") as f:
+                data = f.read()
+            magic, version, n, record_size, _, capacity, count = HEADER.unpack_from(data)
+            if magic != MAGIC or version != VERSION:
+                raise ValueError("{}.{} is not a flight log".format(prefix, index))
+            self.num_actuators = n
+            self.record_size = record_size
+            chunks.append(data[HEADER.size:HEADER.size + count * record_size])
+            index += 1
+            # A segment which is not full is the last one of the log
+            if count < capacity:
+                break
+        if self.num_actuators is None:
+            raise ValueError("No flight log found at {}".format(prefix))
+
+        n = self.num_actuators
+        self.raw = np.frombuffer(b"".join(chunks), dtype=np.uint8).reshape(-1, self.record_size)
+        self.sim_time = self.raw[:, 8:16].copy().view(np.float64).ravel()
+        self.world_control = self.raw[:, 16:20].copy().view(np.uint32).ravel()
+        # The motors are followed by the three target rates
+        self.state_offset = MOTOR_OFFSET + 4 * (n + 3)
+        # Only the IMU values at the start of the state are compared
+        state = self.raw[:, self.state_offset:self.state_offset + 4 * 10].copy().view(np.float32)
+        self.angular_velocity = state[:, 0:3].astype(np.float64)
+        self.orientation = state[:, 6:10].astype(np.float64)
+
+    def __len__(self):
+        return len(self.raw)
+
+    def episodes(self):
+        """Index ranges of each episode, a reset record starts a new one"""
+        starts = [0] + [i for i in np.flatnonzero(self.world_control == RESET) if i > 0]
+        ends = starts[1:] + [len(self)]
+        return list(zip(starts, ends))
+
+    def resample(self, repeat, decimate, path):
+        """Write a copy holding every action repeat times, or keeping only
+        every decimate-th action. Resets and other world controls are
+        always kept once."""
+        rows = []
+        since_reset = 0
+        for i in range(len(self)):
+            if self.world_control[i] != STEP:
+                rows.append(i)
+                if self.world_control[i] == RESET:
+                    since_reset = 0
+                continue
+            if since_reset % decimate == 0:
+                rows.extend([i] * repeat)
+            since_reset += 1
+        records = self.raw[rows].copy()
+        records[:, 0:8] = np.arange(len(rows), dtype=np.uint64).view(np.uint8).reshape(-1, 8)
+        with open(path + ".0", "wb") as f:
+            f.write(HEADER.pack(MAGIC, VERSION, self.num_actuators, self.record_size,
+                                0, len(rows), len(rows)))
+            f.write(records.tobytes())
+
+        # Digital twin swaps are looked up by their new step index
+        if os.path.exists(self.prefix + ".twins"):
+            first = {}
+            for new, old in enumerate(rows):
+                first.setdefault(old, new)
+            with open(self.prefix + ".twins") as src, open(path + ".twins", "w") as dst:
+                for line in src:
+                    step, sdf = line.rstrip("\n").split(" ", 1)
+                    if int(step) in first:
+                        dst.write("{} {}\n".format(first[int(step)], sdf))
+
+
+def divergence(reference, run):
+    """Worst angular velocity and attitude error of the run against the
+    reference, interpolated onto the reference sim time of each episode."""
+    rate_sq = []
+    rate_max = 0.0
+    attitude_max = 0.0
+    for (ref_begin, ref_end), (b, e) in zip(reference.episodes(), run.episodes()):
+        t_ref = reference.sim_time[ref_begin:ref_end]
+        t = run.sim_time[b:e]
+        if len(t) < 2 or len(t_ref) == 0:
+            continue
+        mask = (t_ref >= t[0]) & (t_ref <= t[-1])
+        t_ref = t_ref[mask]
+        if len(t_ref) == 0:
+            continue
+
+        def interp(values):
+            return np.stack([np.interp(t_ref, t, values[b:e, k])
+                             for k in range(values.shape[1])], axis=1)
+
+        rate_error = interp(run.angular_velocity) - reference.angular_velocity[ref_begin:ref_end][mask]
+        rate_sq.append(np.sum(rate_error ** 2, axis=1))
+        rate_max = max(rate_max, float(np.max(np.linalg.norm(rate_error, axis=1))))
+
+        q = interp(run.orientation)
+        q /= np.linalg.norm(q, axis=1, keepdims=True)
+        q_ref = reference.orientation[ref_begin:ref_end][mask]
+        dot = np.clip(np.abs(np.sum(q * q_ref, axis=1)), 0.0, 1.0)
+        attitude_max = max(attitude_max, float(np.max(2 * np.arccos(dot))))
+
+    rate_rms = float(np.sqrt(np.mean(np.concatenate(rate_sq)))) if rate_sq else float("nan")
+    return rate_rms, rate_max, attitude_max
+
+
+def write_world(template, engine, step_size, path):
+    """Copy of the world with its physics replaced by the given engine"""
+    tree = ET.parse(template)
+    world = tree.getroot().find("world")
+    for physics in world.findall("physics"):
+        world.remove(physics)
+    physics = ET.Element("physics", {"type": engine})
+    ET.SubElement(physics, "real_time_update_rate").text = "0"
+    ET.SubElement(physics, "max_step_size").text = repr(step_size)
+    world.insert(0, physics)
+    tree.write(path)
+
+
+def hold_factors(trace_step_size, step_size):
+    """Number of times each action is repeated or the decimation needed to
+    hold every action for the sim time it was recorded with"""
+    ratio = trace_step_size / step_size
+    if ratio >= 1:
+        repeat, decimate = int(round(ratio)), 1
+    else:
+        repeat, decimate = 1, int(round(1 / ratio))
+    if not np.isclose(step_size * repeat, trace_step_size * decimate):
+        raise ValueError("Step size {} is not a multiple or divisor of the trace step size {}".format(
+            step_size, trace_step_size))
+    return repeat, decimate
+
+
+def run(args, env, world_path, trace, record, log_path):
+    run_env = env.copy()
+    run_env["GYMFC_REPLAY_PATH"] = trace
+    run_env["GYMFC_RECORD_PATH"] = record
+    with open(log_path, "w") as log:
+        try:
+            subprocess.run(["gzserver", "--verbose", world_path], env=run_env,
+                           stdout=log, stderr=subprocess.STDOUT, timeout=args.timeout)
+        except subprocess.TimeoutExpired:
+            return None
+    with open(log_path) as log:
+        output = log.read()
+    step = STEP_RATE.search(output)
+    if not step:
+        return None
+    result = {"steps_per_sec": float(step.group(1)), "reset_ms": float("nan")}
+    reset = RESET_RATE.search(output)
+    if reset:
+        result["reset_ms"] = float(reset.group(2))
+        result["steps_per_sec"] = float(reset.group(3))
+    return result
+
+
+def main():
+    assets = os.path.abspath(os.path.join(os.path.dirname(__file__), "..", ".."))
+    parser = argparse.ArgumentParser("Benchmark the digital twin across physics engines and step sizes.")
+    parser.add_argument("twin", help="File path of the digital twin SDF.")
+    parser.add_argument("trace", help="Prefix of a recorded flight log to replay.")
+    parser.add_argument("--world", default=os.path.join(assets, "worlds", "attitude.world"),
+                        help="World the physics element is replaced in.")
+    parser.add_argument("--engines", nargs="+", default=["dart", "ode", "bullet"])
+    parser.add_argument("--step-sizes", nargs="+", type=float, default=[0.001, 0.0005, 0.002])
+    parser.add_argument("--trace-step-size", type=float, default=0.001,
+                        help="Max step size the trace was recorded with.")
+    parser.add_argument("--plugin-dir", default=os.path.join(assets, "plugins", "build"))
+    parser.add_argument("--output", default=None, help="Directory the worlds, logs and records are kept in.")
+    parser.add_argument("--gz-port", type=int, default=11360, help="Gazebo master port used for the runs.")
+    parser.add_argument("--timeout", type=float, default=600, help="Seconds a single run may take.")
+    args = parser.parse_args()
+
+    twin = os.path.abspath(args.twin)
+    trace = FlightLog(args.trace)
+    output = args.output or tempfile.mkdtemp(prefix="gymfc_physics_")
+    os.makedirs(output, exist_ok=True)
+
+    # Same paths FlightControlEnv sets up for the simulator
+    env = os.environ.copy()
+    env["GYMFC_SITL_PORT"] = "0"
+    env["GYMFC_DIGITAL_TWIN_SDF"] = twin
+    env["GAZEBO_MASTER_URI"] = "http://localhost:{}".format(args.gz_port)
+    paths = {
+        "GAZEBO_MODEL_PATH": [os.path.join(assets, "models"), os.path.abspath(os.path.join(twin, "../../"))],
+        "GAZEBO_RESOURCE_PATH": [os.path.join(assets, "worlds")],
+        "GAZEBO_PLUGIN_PATH": [os.path.abspath(args.plugin_dir),
+                               os.path.abspath(os.path.join(twin, "../plugins/build"))],
+    }
+    for name, extra in paths.items():
+        env[name] = os.pathsep.join([p for p in [env.get(name)] if p] + extra)
+
+    results = []
+    reference = None
+    for step_size in args.step_sizes:
+        repeat, decimate = hold_factors(args.trace_step_size, step_size)
+        resampled = os.path.join(output, "trace_{}".format(step_size))
+        trace.resample(repeat, decimate, resampled)
+        for engine in args.engines:
+            name = "{}_{}".format(engine, step_size)
+            world_path = os.path.join(output, name + ".world")
+            record = os.path.join(output, name)
+            write_world(args.world, engine, step_size, world_path)
+            print("Running {} ...".format(name), file=sys.stderr)
+            result = run(args, env, world_path, resampled, record, record + ".log")
+            if result is None:
+                print("{} failed, see {}.log".format(name, record), file=sys.stderr)
+                results.append((engine, step_size, None, None))
+                continue
+            log = FlightLog(record)
+            if reference is None:
+                reference = log
+                reference_name = name
+            results.append((engine, step_size, result, divergence(reference, log)))
+
+    print("{:<8} {:>9} {:>11} {:>10} {:>14} {:>14} {:>14}".format(
+        "engine", "step", "steps/s", "reset ms", "rate rms", "rate max", "attitude max"))
+    for engine, step_size, result, error in results:
+        if result is None:
+            print("{:<8} {:>9g} {:>11}".format(engine, step_size, "failed"))
+            continue
+        print("{:<8} {:>9g} {:>11.0f} {:>10.2f} {:>14.3e} {:>14.3e} {:>14.3e}".format(
+            engine, step_size, result["steps_per_sec"], result["reset_ms"], *error))
+    if reference is not None:
+        print("Divergence is against {} in rad/s and rad".format(reference_name), file=sys.stderr)
+    print("Worlds, logs and records are kept in {}".format(output), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
@@ -6,9 +6,9 @@ import numpy as np
 import os
 import os.path
 import subprocess
+import select
 import signal
 import sys
-import xml.etree.ElementTree as ET
 import psutil
 import time
 import configparser
@@ -21,17 +21,29 @@ from google.protobuf import descriptor
 
 
 class ActionPacket:
-    def __init__(self, motor, world_control=Action_pb2.Action.STEP):
+    def __init__(self, motor, world_control=Action_pb2.Action.STEP, randomize=False, seed=None, digital_twin_sdf=None, target_rate=None):
         """
         Args:
             motor (np.array): an array of motor control signals.  
             world_control: 
+            randomize (bool): on reset, perturb the digital twin parameters
+            seed (int): optional seed of the perturbation
+            digital_twin_sdf (string): SDF file path to load with LOAD_DIGITAL_TWIN
+            target_rate (np.array): desired rates for the plugin rate error reward
         """
         self.motor = motor 
         self.ac = Action_pb2.Action()
         #print ("Sending motor ", motor.tolist())
         self.ac.motor.extend(motor.tolist())
         self.ac.world_control = world_control
+        if randomize:
+            self.ac.randomize = True
+            if seed is not None:
+                self.ac.seed = seed
+        if digital_twin_sdf:
+            self.ac.digital_twin_sdf = digital_twin_sdf
+        if target_rate is not None:
+            self.ac.target_rate.extend(np.asarray(target_rate).tolist())
 
     def encode(self):
         """  Encode packet data"""
@@ -63,7 +75,7 @@ class ActionProtocol:
     def connection_made(self, transport):
         self.transport = transport
 
-    async def write(self, motor_values, world_control=Action_pb2.Action.STEP):
+    async def write(self, motor_values, world_control=Action_pb2.Action.STEP, randomize=False, seed=None, digital_twin_sdf=None, target_rate=None):
         """ Write the motor values to the ESC and then return 
         the current sensor values and an exception if anything bad happend.
         
@@ -72,7 +84,7 @@ class ActionProtocol:
         """
         self.packet_received = False
         self.send_time = time.time()
-        self.transport.sendto(ActionPacket(motor_values, world_control).encode())
+        self.transport.sendto(ActionPacket(motor_values, world_control, randomize, seed, digital_twin_sdf, target_rate).encode())
 
         # Pass the exception back if anything bad happens
         while not self.packet_received:
@@ -153,17 +165,20 @@ class FlightControlEnv(ABC):
         else:
             self.loop = loop
 
-        self.stepsize = self.sdf_max_step_size()        
         self.sim_time = 0
-        self.last_sim_time = -self.stepsize
 
         # Set up some stats to report at the end, connection are over UDP
         # so it can be useful to see if anything is dropped
         self.sim_stats = {}
         self.sim_stats["steps"] = 0
         self.sim_stats["packets_dropped"] = 0
+        self.sim_stats["sensor_timeouts"] = 0
         self.sim_stats["time_start_seconds"] = time.time()
 
+        # The plugin picks its own port, which is only known once the
+        # server reports it through the handshake
+        self._start_sim()
+
         print ("Sending motor control signals to port ", self.aircraft_port)
         # Connect to the Aircraft plugin
         writer = self.loop.create_datagram_endpoint(
@@ -171,7 +186,8 @@ class FlightControlEnv(ABC):
             remote_addr=(self.host, self.aircraft_port))
         _, self.ac_protocol = self.loop.run_until_complete(writer) 
 
-        self._start_sim()
+        self._query_info()
+        self.last_sim_time = -self.stepsize
 
     def load_config(self, aircraft_config, config_filepath = None):
         """ Load the JSON configuration file defined by the environment 
@@ -221,31 +237,37 @@ class FlightControlEnv(ABC):
             )
         else:
             self.gz_port = default.getint("GazeboNetworkPortRangeBegin")
+        # The plugin binds the first free port of the range itself so 
+        # parallel instances can not race for the same port
         if cfg.has_option("DEFAULT", "FCPluginPortRangeEnd"):
-            self.aircraft_port = self._get_open_port(
-                np.random.randint(
-                    default.getint("FCPluginPortRangeBegin"),
-                    default.getint("FCPluginPortRangeEnd"))
-            )
+            self.aircraft_port_range = "{}-{}".format(
+                default.getint("FCPluginPortRangeBegin"),
+                default.getint("FCPluginPortRangeEnd"))
         else:
-            self.aircraft_port = default.getint("FCPluginPortRangeBegin")
+            self.aircraft_port_range = str(default.getint("FCPluginPortRangeBegin"))
+        self.aircraft_port = None
+        self.handshake_timeout = default.getfloat("HandshakeTimeout", fallback=120)
 
 
 
-        self._parse_model_sdf()
+        if not os.path.isfile(self.aircraft_sdf_filepath):
+            message = "Aircraft SDF file  at location '{}' does not exist.".format(self.aircraft_sdf_filepath)
+            raise ConfigLoadException(message)
 
-    def step_sim(self, ac):
+    def step_sim(self, ac, target_rate=None):
         """ Take a single step in the simulator and return the current 
         observations.
         Args:
             ac (np.array): Action to take in the environment bounded by 
             output range specificed in config.
+            target_rate (np.array): desired rates in rad/s when the world
+            computes the rate error reward
 
         Returns:
             Numpy array defining the environment observations
         """
 
-        return self.loop.run_until_complete(self._step_sim(ac))
+        return self.loop.run_until_complete(self._step_sim(ac, target_rate=target_rate))
 
     def _flatten_ob(self):
         """ Convert the state packet with observations returned from the digital twin to a single 
@@ -272,7 +294,7 @@ class FlightControlEnv(ABC):
             
         return np.array(ob).flatten()
 
-    async def _step_sim(self, ac, world_control=Action_pb2.Action.STEP):
+    async def _step_sim(self, ac, world_control=Action_pb2.Action.STEP, randomize=False, seed=None, digital_twin_sdf=None, target_rate=None):
         """Complete a single simulation step, return a tuple containing
         the simulation time and the state
 
@@ -292,7 +314,7 @@ class FlightControlEnv(ABC):
         # try again or for some reason something goes wrong in the simualator and 
         # the packet wasnt processsed correctly. 
         for i in range(self.MAX_CONNECT_TRIES):
-            self.state_message, e = await self.ac_protocol.write(ac, world_control=world_control)
+            self.state_message, e = await self.ac_protocol.write(ac, world_control=world_control, randomize=randomize, seed=seed, digital_twin_sdf=digital_twin_sdf, target_rate=target_rate)
             if self.state_message:
                 break
             if i == self.MAX_CONNECT_TRIES -1:
@@ -301,6 +323,25 @@ class FlightControlEnv(ABC):
                 raise SystemExit("Timeout communicating with flight control plugin.")
             await asyncio.sleep(1)
 
+        # The plugin gave up waiting on some sensors, their values are
+        # from the previous step
+        if self.state_message.stale_sensors:
+            self.sim_stats["sensor_timeouts"] = self.state_message.sensor_timeouts
+            logger.warning("Sensors timed out, stale sensor mask {:#x}".format(self.state_message.stale_sensors))
+
+        # Frames stacked by the plugin, one row per step oldest first
+        if self.history_length and len(self.state_message.history):
+            self.history = np.array(self.state_message.history).reshape(self.history_length, -1)
+            if self.history_actions:
+                self.action_history = np.array(self.state_message.action_history).reshape(self.history_length, -1)
+
+        # Computed by the plugin when the world configures a reward or
+        # termination, zero otherwise
+        self.reward = self.state_message.reward
+        self.done = self.state_message.done
+        self.termination = self.state_message.termination
+        self.link_drift = self.state_message.link_drift
+
         # Handle some special cases
         self.sim_time = np.around(self.state_message.sim_time , 3)
         self.force = self.state_message.force
@@ -367,57 +408,6 @@ class FlightControlEnv(ABC):
 
         env.update(gz_env)
 
-    def _parse_model_sdf(self):
-
-        # Digital twin
-        if not os.path.isfile(self.aircraft_sdf_filepath):
-            message = "Aircraft SDF file  at location '{}' does not exist.".format(self.aircraft_sdf_filepath)
-            raise ConfigLoadException(message)
-
-        tree = ET.parse(self.aircraft_sdf_filepath)
-        root = tree.getroot()
-        els = root.findall(".//plugin[@filename='libAircraftConfigPlugin.so']")
-        if len(els) != 1:
-            raise SystemExit("Could not find plugin with filename {} from SDF file {} required to load the aircraft model.".format("libAircraftConfigPlugin.so", model_sdf))
-        plugin_el = els[0]
-
-        self.motor_count = int(plugin_el.find("motorCount").text)
-        self._get_supported_sensors(plugin_el)
-
-
-    def _get_supported_sensors(self, plugin_el):
-        sdf_to_protobuf = {
-            "imu": {
-                "enable_angular_velocity": "imu_angular_velocity_rpy",
-                "enable_linear_acceleration": "imu_linear_acceleration_xyz",
-                "enable_orientation":"imu_orientation_quat",
-            },
-            "esc": {
-                "enable_angular_velocity": "esc_motor_angular_velocity",
-                "enable_temperature": "esc_temperature",
-                "enable_current": "esc_current",
-                "enable_voltage": "esc_voltage",
-                "enable_force": "esc_force",
-                "enable_torque": "esc_torque"
-            },
-            "battery": {
-                "enable_voltage":  "vbat_voltage",
-                "enable_current": "vbat_current"
-            },
-            "position": {
-                "enable_gps": "gps"
-            }
-        }
-        sensors = plugin_el.find("sensors")
-        for sensor in sensors.findall("sensor"):
-            sensor_type = sensor.attrib["type"]
-            if sensor_type in sdf_to_protobuf:
-                for enabled in sensor:
-                    if enabled.text.lower() == "true":
-                        self.enabled_sensor_measurements.append(sdf_to_protobuf[sensor_type][enabled.tag])
-            else:
-                raise SystemExit("Unsupported sensor {} found in SDF file".format(sensor_type))
-
     def _plugins_exist(self, build_path):
         return (os.path.isfile(os.path.join(build_path, "libFlightControllerPlugin.so")) and 
             os.path.isfile(os.path.join(build_path, "libAircraftConfigPlugin.so")))
@@ -430,14 +420,15 @@ class FlightControlEnv(ABC):
         # XXX
         #signal.signal(signal.SIGINT, self._signal_handler)
 
-        # Port the aircraft reads in through this environment variable,
-        # this is the network channel set up to pass sensor and ESC
-        # data back and forth
-        # XXX Could actual be a race condition if 2+ processes are started 
-        # at the same time
+        # Port range the aircraft binds in, read in through this environment 
+        # variable, this is the network channel set up to pass sensor and ESC
+        # data back and forth. The port actually bound is sent back over
+        # the handshake pipe.
         container_env = os.environ.copy()
 
-        container_env["GYMFC_SITL_PORT"] = str(self.aircraft_port)
+        container_env["GYMFC_SITL_PORT"] = self.aircraft_port_range
+        handshake_r, handshake_w = os.pipe()
+        container_env["GYMFC_HANDSHAKE_FD"] = str(handshake_w)
         container_env["GYMFC_DIGITAL_TWIN_SDF"] = self.aircraft_sdf_filepath
 
         # Source the gazebo setup file to set up vars needed by the simuluator
@@ -482,26 +473,66 @@ aircraft_plugin_dir)
         target_world = os.path.join(gz_assets_path, "worlds", self.world)
         p = None
         if self.verbose:
-            p = subprocess.Popen(["gzserver", "--verbose", target_world], shell=False, env=container_env) 
+            p = subprocess.Popen(["gzserver", "--verbose", target_world], shell=False, env=container_env, pass_fds=(handshake_w,)) 
         else:
-            p = subprocess.Popen(["gzserver", target_world], shell=False, env=container_env) 
+            p = subprocess.Popen(["gzserver", target_world], shell=False, env=container_env, pass_fds=(handshake_w,)) 
+        os.close(handshake_w)
         self.env = container_env
         print ("Starting gzserver with process ID=", p.pid)
         self.process_ids.append(p.pid)
 
+        self._read_handshake(handshake_r, p)
 
-    def sdf_max_step_size(self):
-        """ Return the max step size read and parsed from the world file"""
-        gz_assets = os.path.join(os.path.dirname(__file__), "assets/gazebo/")
-        world_filepath = os.path.join(gz_assets, "worlds", self.world)
+    def _read_handshake(self, fd, p):
+        """ Wait for the plugin to report the port it bound and the layout
+        of the digital twin it loaded.
 
-        tree = ET.parse(world_filepath)
-        root = tree.getroot()
-        els = root.findall("./world/physics/max_step_size")
-        if len(els) == 0:
-            raise SDFNoMaxStepSizeFoundException()
+        Args:
+            fd (int): Read end of the handshake pipe, closed on return
+            p (subprocess.Popen): The gzserver process
+        """
+        data = b""
+        deadline = time.time() + self.handshake_timeout
+        try:
+            while not data.endswith(b"\n"):
+                remaining = deadline - time.time()
+                if remaining <= 0:
+                    raise SystemExit("Timed out waiting for the flight controller plugin handshake.")
+                ready, _, _ = select.select([fd], [], [], remaining)
+                if not ready:
+                    continue
+                chunk = os.read(fd, 4096)
+                if not chunk:
+                    raise SystemExit("gzserver exited before the flight controller plugin handshake, exit code {}.".format(p.poll()))
+                data += chunk
+        finally:
+            os.close(fd)
+
+        handshake = json.loads(data.decode())
+        self.aircraft_port = handshake["port"]
+
+    def _query_info(self):
+        """ Read the motor count, step size, physics engine and observation
+        layout from the plugin, which parsed the digital twin and world so
+        the client can never disagree with it."""
+        for i in range(self.MAX_CONNECT_TRIES):
+            state, e = self.loop.run_until_complete(self.ac_protocol.write(np.zeros(0), world_control=Action_pb2.Action.INFO))
+            if state:
+                break
+            if i == self.MAX_CONNECT_TRIES -1:
+                self.shutdown()
+                raise SystemExit("Timeout requesting environment info from flight control plugin.")
+
+        self.state_message = state
+        self.motor_count = state.info.motor_count
+        self.stepsize = state.info.step_size
+        self.physics_engine = state.info.physics_engine
+        self.enabled_sensor_measurements = list(state.info.fields)
+        self.sensor_units = dict(zip(state.info.fields, state.info.units))
+        self.thread_placement = {t.name: t for t in state.info.threads}
+        self.history_length = state.info.history_length
+        self.history_actions = state.info.history_actions
 
-        return float(els[0].text)
 
     def _get_open_port(self, start_port):
         """ Return an available open port, starting from start_port
@@ -539,8 +570,13 @@ aircraft_plugin_dir)
         self.print_post_simulation_stats()
         self.kill_sim()
 
-    def reset(self):
+    def reset(self, randomize=False, seed=None):
         """ Reset the environment (compatible with OpenAI API).
+
+        Args:
+            randomize (bool): perturb the physical parameters of the digital
+                twin within the ranges configured in the world file.
+            seed (int): optional seed making the perturbation reproducible.
         
         Warning: When inheriting this class you will most likely need to override
         this method and call super to reset any internal state used in the child 
@@ -549,10 +585,27 @@ aircraft_plugin_dir)
         # its possible well miss the recieve message
         self.last_sim_time = -self.stepsize
         # Motor values are ignored during a reset so just send whatever
-        ob = self.loop.run_until_complete(self._step_sim(np.zeros(self.motor_count), world_control=Action_pb2.Action.RESET))
+        ob = self.loop.run_until_complete(self._step_sim(np.zeros(self.motor_count), world_control=Action_pb2.Action.RESET, randomize=randomize, seed=seed))
         assert np.isclose(self.sim_time, 0.0, 1e-6), "sim time after reset is incorrect, {} ".format(self.sim_time)
         return ob
 
+    def load_digital_twin(self, aircraft_config):
+        """ Replace the aircraft in the running simulator without restarting
+        Gazebo. The new aircraft is left in the reset state.
+
+        Args:
+            aircraft_config: File path of the new aircraft Gazebo SDF file
+        """
+        self.aircraft_sdf_filepath = os.path.abspath(aircraft_config)
+        self.last_sim_time = -self.stepsize
+        self.loop.run_until_complete(self._step_sim(np.zeros(self.motor_count), world_control=Action_pb2.Action.LOAD_DIGITAL_TWIN, digital_twin_sdf=self.aircraft_sdf_filepath))
+        if self.state_message.status_code != State_pb2.State.OK:
+            raise SystemExit("Flight control plugin could not load aircraft {}".format(aircraft_config))
+        # The new twin can have a different layout, INFO does not step so
+        # the reply still holds the state after loading
+        self._query_info()
+        return self._flatten_ob()
+
     def close(self):
         self.shutdown()
 
@@ -563,9 +616,6 @@ aircraft_plugin_dir)
 
 
 
-class SDFNoMaxStepSizeFoundException(Exception):
-    pass
-
 class ConfigLoadException(Exception):
     pass
 
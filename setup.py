@@ -54,5 +54,5 @@ setup(name='gymfc',
       ]},
       include_package_data=True,
       cmdclass={'build': CustomBuild},
-      install_requires=['gym', 'numpy', 'protobuf', 'psutil>=5.3.0'],
+      install_requires=['gym', 'numpy', 'protobuf>=3.20', 'psutil>=5.3.0'],
 )